@@ -0,0 +1,24 @@
+#include "analyzer.h"
+#include <iostream>
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> [MapOut]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	RomAnalysis analysis;
+	if (!analysis.load_rom(argv[1])) {
+		std::cerr << "Could not read " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	analysis.print_report();
+
+	if (argc == 3 && !analysis.save_map(argv[2])) {
+		std::cerr << "Could not write " << argv[2] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return 0;
+}
@@ -0,0 +1,327 @@
+#include "analyzer.h"
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+static uint16_t fetch(const std::array<uint8_t, MEMORY_SIZE> &image, uint16_t addr)
+{
+        return (image[addr] << 8u) | image[addr + 1];
+}
+
+bool RomAnalysis::load_rom(std::string filename)
+{
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        std::streampos size = file.tellg();
+        if (size > static_cast<std::streampos>(MEMORY_SIZE - START_ADDRESS))
+        {
+                size = MEMORY_SIZE - START_ADDRESS;
+        }
+
+        std::array<uint8_t, MEMORY_SIZE> rom{};
+        file.seekg(0, std::ios::beg);
+        file.read(reinterpret_cast<char *>(rom.data() + START_ADDRESS), size);
+
+        analyze(rom, size);
+        return true;
+}
+
+void RomAnalysis::analyze(const std::array<uint8_t, MEMORY_SIZE> &rom, unsigned int size)
+{
+        image = rom;
+        rom_size = size;
+        map.fill(0);
+        blocks.clear();
+        self_modifying = false;
+        unknown_store = false;
+        has_indirect = false;
+
+        find_code();
+        build_blocks();
+        scan_memory_access();
+}
+
+// Walks every path from the entry point, marking instructions and block leaders
+void RomAnalysis::find_code()
+{
+        std::vector<uint16_t> worklist{START_ADDRESS};
+        map[START_ADDRESS] |= MAP_LEADER;
+
+        auto branch_to = [&](unsigned int target) {
+                if (target + 1 < MEMORY_SIZE)
+                {
+                        map[target] |= MAP_LEADER;
+                        worklist.push_back(target);
+                }
+        };
+
+        while (!worklist.empty())
+        {
+                unsigned int addr = worklist.back();
+                worklist.pop_back();
+
+                while (addr + 1 < MEMORY_SIZE && !(map[addr] & MAP_CODE))
+                {
+                        map[addr] |= MAP_CODE;
+                        map[addr + 1] |= MAP_OPERAND;
+
+                        Instruction ins = decode(fetch(image, addr));
+
+                        if (ins.op == Op::OP_1NNN)
+                        {
+                                branch_to(ins.nnn);
+                                break;
+                        }
+                        else if (ins.op == Op::OP_2NNN)
+                        {
+                                branch_to(ins.nnn);
+                                branch_to(addr + 2);
+                                break;
+                        }
+                        else if (ins.op == Op::OP_00EE)
+                        {
+                                break;
+                        }
+                        else if (ins.op == Op::OP_BNNN)
+                        {
+                                map[addr] |= MAP_INDIRECT;
+                                has_indirect = true;
+                                break;
+                        }
+                        else if (is_skip(ins.op))
+                        {
+                                branch_to(addr + 2);
+                                branch_to(addr + 4);
+                                break;
+                        }
+
+                        addr += 2;
+                }
+        }
+}
+
+void RomAnalysis::build_blocks()
+{
+        for (unsigned int leader = 0; leader < MEMORY_SIZE; ++leader)
+        {
+                if (!(map[leader] & MAP_LEADER) || !(map[leader] & MAP_CODE))
+                {
+                        continue;
+                }
+
+                BasicBlock block{};
+                block.start = leader;
+
+                unsigned int addr = leader;
+                while (true)
+                {
+                        Instruction ins = decode(fetch(image, addr));
+                        unsigned int next = addr + 2;
+
+                        if (ends_block(ins.op))
+                        {
+                                block.end = next;
+                                if (ins.op == Op::OP_1NNN)
+                                {
+                                        block.successors.push_back(ins.nnn);
+                                }
+                                else if (ins.op == Op::OP_2NNN)
+                                {
+                                        block.successors.push_back(ins.nnn);
+                                        block.successors.push_back(next);
+                                }
+                                else if (ins.op == Op::OP_00EE)
+                                {
+                                        block.returns = true;
+                                }
+                                else if (ins.op == Op::OP_BNNN)
+                                {
+                                        block.indirect = true;
+                                }
+                                else
+                                {
+                                        block.successors.push_back(next);
+                                        block.successors.push_back(next + 2);
+                                }
+                                break;
+                        }
+
+                        if (next + 1 >= MEMORY_SIZE || !(map[next] & MAP_CODE))
+                        {
+                                // Runs off the end of memory
+                                block.end = next;
+                                break;
+                        }
+
+                        if (map[next] & MAP_LEADER)
+                        {
+                                block.end = next;
+                                block.successors.push_back(next);
+                                break;
+                        }
+
+                        addr = next;
+                }
+
+                blocks[leader] = block;
+        }
+}
+
+// Tracks I through each block to find what Dxyn/Fx65 read and Fx33/Fx55 write
+void RomAnalysis::scan_memory_access()
+{
+        auto mark = [&](unsigned int from, unsigned int count, uint8_t flag) {
+                for (unsigned int i = from; i < from + count && i < MEMORY_SIZE; ++i)
+                {
+                        map[i] |= flag;
+                        if (flag == MAP_WRITTEN && (map[i] & (MAP_CODE | MAP_OPERAND)))
+                        {
+                                self_modifying = true;
+                        }
+                }
+        };
+
+        for (auto &[start, block] : blocks)
+        {
+                bool known = false;
+                unsigned int i_reg = 0;
+
+                for (unsigned int addr = block.start; addr < block.end; addr += 2)
+                {
+                        Instruction ins = decode(fetch(image, addr));
+
+                        switch (ins.op)
+                        {
+                        case Op::OP_ANNN:
+                                known = true;
+                                i_reg = ins.nnn;
+                                break;
+                        case Op::OP_FX1E:
+                        case Op::OP_FX29:
+                                known = false;
+                                break;
+                        case Op::OP_DXYN:
+                                if (known)
+                                {
+                                        mark(i_reg, ins.n, MAP_DATA);
+                                }
+                                break;
+                        case Op::OP_FX65:
+                                if (known)
+                                {
+                                        mark(i_reg, ins.x + 1, MAP_DATA);
+                                }
+                                break;
+                        case Op::OP_FX33:
+                        case Op::OP_FX55:
+                                if (known)
+                                {
+                                        mark(i_reg, ins.op == Op::OP_FX33 ? 3 : ins.x + 1, MAP_WRITTEN);
+                                }
+                                else
+                                {
+                                        // Could land anywhere, code included
+                                        block.unknown_store = true;
+                                        unknown_store = true;
+                                        self_modifying = true;
+                                }
+                                break;
+                        default:
+                                break;
+                        }
+                }
+        }
+}
+
+void RomAnalysis::print_report() const
+{
+        unsigned int code_bytes = 0;
+        unsigned int data_bytes = 0;
+        unsigned int unknown_bytes = 0;
+        for (unsigned int i = START_ADDRESS; i < START_ADDRESS + rom_size; ++i)
+        {
+                if (map[i] & (MAP_CODE | MAP_OPERAND))
+                {
+                        ++code_bytes;
+                }
+                else if (map[i] & MAP_DATA)
+                {
+                        ++data_bytes;
+                }
+                else
+                {
+                        ++unknown_bytes;
+                }
+        }
+
+        std::cout << std::dec << "ROM size: " << rom_size << " bytes\n";
+        std::cout << "Code: " << code_bytes << "  Data: " << data_bytes << "  Unreferenced: " << unknown_bytes << "\n";
+        std::cout << "Blocks: " << blocks.size() << "\n";
+        std::cout << "Indirect jumps: " << (has_indirect ? "yes" : "no") << "\n";
+        std::cout << "Self-modifying: " << (self_modifying ? "yes" : "no")
+                  << (unknown_store ? " (stores through an unknown I may reach code)" : "") << "\n\n";
+
+        for (auto const &[start, block] : blocks)
+        {
+                std::cout << std::hex << "0x" << block.start << "-0x" << block.end << " ->";
+                for (uint16_t succ : block.successors)
+                {
+                        std::cout << " 0x" << succ;
+                }
+                if (block.returns)
+                {
+                        std::cout << " [ret]";
+                }
+                if (block.indirect)
+                {
+                        std::cout << " [indirect]";
+                }
+                if (block.unknown_store)
+                {
+                        std::cout << " [store via unknown I]";
+                }
+                std::cout << "\n";
+        }
+        std::cout << std::dec;
+}
+
+bool RomAnalysis::save_map(std::string filename) const
+{
+        std::ofstream file(filename, std::ios::binary);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        file.write(CODE_MAP_MAGIC, sizeof(CODE_MAP_MAGIC));
+        file.put(CODE_MAP_VERSION);
+        file.write(reinterpret_cast<const char *>(map.data()), map.size());
+        return file.good();
+}
+
+bool load_code_map(std::string filename, CodeMap &map)
+{
+        std::ifstream file(filename, std::ios::binary);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        char magic[sizeof(CODE_MAP_MAGIC)];
+        file.read(magic, sizeof(magic));
+        if (!file || !std::equal(magic, magic + sizeof(magic), CODE_MAP_MAGIC) || file.get() != CODE_MAP_VERSION)
+        {
+                return false;
+        }
+
+        file.read(reinterpret_cast<char *>(map.data()), map.size());
+        return file.gcount() == static_cast<std::streamsize>(map.size());
+}
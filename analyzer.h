@@ -0,0 +1,59 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-address flags of a code/data map
+const uint8_t MAP_CODE = 0x01;        // first byte of a reachable instruction
+const uint8_t MAP_OPERAND = 0x02;     // second byte of a reachable instruction
+const uint8_t MAP_DATA = 0x04;        // read through I by Dxyn/Fx65
+const uint8_t MAP_LEADER = 0x08;      // first instruction of a basic block
+const uint8_t MAP_INDIRECT = 0x10;    // Bnnn jump site, target unknown
+const uint8_t MAP_WRITTEN = 0x20;     // stored to by Fx33/Fx55
+
+// Code/data map file: "C8MP", version byte, then one flag byte per address
+const char CODE_MAP_MAGIC[4] = {'C', '8', 'M', 'P'};
+const uint8_t CODE_MAP_VERSION = 1;
+
+using CodeMap = std::array<uint8_t, MEMORY_SIZE>;
+
+struct BasicBlock
+{
+        uint16_t start;
+        uint16_t end;                     // address past the last instruction
+        std::vector<uint16_t> successors;
+        bool indirect;                    // ends in Bnnn
+        bool returns;                     // ends in 00EE
+        bool unknown_store;               // Fx33/Fx55 with I not known statically
+};
+
+class RomAnalysis
+{
+public:
+        // Analyzes a memory image laid out the way Chip8::load_rom does
+        void analyze(const std::array<uint8_t, MEMORY_SIZE> &image, unsigned int rom_size);
+        bool load_rom(std::string filename);
+
+        void print_report() const;
+        bool save_map(std::string filename) const;
+
+        CodeMap map{};
+        std::map<uint16_t, BasicBlock> blocks;
+        std::array<uint8_t, MEMORY_SIZE> image{};
+        unsigned int rom_size{};
+        bool self_modifying{};    // a store may hit reachable code
+        bool unknown_store{};     // a reachable Fx33/Fx55 stores through an I not known statically
+        bool has_indirect{};      // control flow leaves the static CFG
+
+private:
+        void find_code();
+        void build_blocks();
+        void scan_memory_access();
+};
+
+// Loads a map written by RomAnalysis::save_map
+bool load_code_map(std::string filename, CodeMap &map);
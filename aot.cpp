@@ -0,0 +1,25 @@
+#include "aot.h"
+
+void aot_run(Chip8 &chip8, AotEntry entry, unsigned int count)
+{
+        uint64_t interpreted = 0;
+        uint64_t total = count;
+#ifdef CHIP8_VIP_TIMING
+        bool compiled = false;
+#else
+        bool compiled = !chip8.coverage && !chip8.store_watch;
+#endif
+        while (count > 0)
+        {
+                unsigned int done = compiled ? entry(chip8, count) : 0;
+                if (done == 0)
+                {
+                        chip8.cycle();
+                        ++interpreted;
+                        done = 1;
+                }
+                count -= done;
+        }
+        metric_add(METRIC_AOT_COMPILED, total - interpreted);
+        metric_add(METRIC_AOT_INTERPRETED, interpreted);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "chip8.h"
+
+// Entry point of a ROM translated by chip8-recompile.
+//
+// Runs compiled blocks starting at the current pc, executing at most budget
+// instructions, and returns how many ran. Returns early (possibly 0) when pc
+// is not the start of a compiled block, the next block does not fit in the
+// budget, or its code bytes were modified at runtime.
+using AotEntry = unsigned int (*)(Chip8 &, unsigned int budget);
+
+// Primary template for generated code, each ROM specializes it with its own tag
+template <typename Program>
+struct Recompiled;
+
+// Runs count instructions, in compiled code where possible and through
+// Chip8::cycle everywhere else.
+//
+// Compiled blocks call the handlers and Chip8::retire but skip the rest of
+// Chip8::cycle: they record no coverage, and a Debugger would miss
+// breakpoints inside them. They also know nothing of the VIP cycle budget or
+// the wait for vertical blank after Dxyn. So with coverage or store_watch
+// set, or with CHIP8_VIP_TIMING, everything goes through Chip8::cycle.
+void aot_run(Chip8 &chip8, AotEntry entry, unsigned int count);
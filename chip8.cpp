@@ -1,275 +1,492 @@
 #include "chip8.h"
-
+#include "coverage.h"
+#include "isa.h"
+#include "key_events.h"
+#include "state_dump.h"
+#include "xxhash64.h"
+#ifdef CHIP8_VIP_TIMING
+#include "vip_timing.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
-#include <iostream>
-#include <bitset>
-#include <chrono>
-
-const unsigned int FONTSET_SIZE = 80;
-const unsigned int FONTSET_START_ADDRESS = 0x50;
-const unsigned int START_ADDRESS = 0x200;
+#include <cstdio>
 
-Chip8::Chip8()
-    : pc(0x200u), index(0x0u), sound_timer(0x0u), delay_timer(0x0u), sp(0x0u),
-      rand_gen(std::chrono::system_clock::now().time_since_epoch().count())
-{
+// Out-of-range addresses and stack levels wrap instead of leaving the arrays
+const unsigned int ADDRESS_MASK = MEMORY_SIZE - 1;
+const unsigned int STACK_MASK = STACK_LEVELS - 1;
 
-        rand_byte = std::uniform_int_distribution<uint8_t>(0, 255u);
+const std::array<uint32_t, VIDEO_WIDTH * VIDEO_HEIGHT> BLANK_DISPLAY{};
 
-        fontset =
-            {
-                0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-                0x20, 0x60, 0x20, 0x20, 0x70, // 1
-                0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-                0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-                0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-                0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-                0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-                0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-                0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-                0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-                0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-                0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-                0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-                0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-                0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-                0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-            };
+// Copies the memory pages and display rows set in pages and rows
+static void copy_changed(std::array<uint8_t, MEMORY_SIZE> &memory_to, const std::array<uint8_t, MEMORY_SIZE> &memory_from,
+                         std::array<uint32_t, VIDEO_WIDTH * VIDEO_HEIGHT> &display_to,
+                         const std::array<uint32_t, VIDEO_WIDTH * VIDEO_HEIGHT> &display_from, uint16_t pages,
+                         uint32_t rows)
+{
+        for (; pages != 0; pages &= pages - 1)
+        {
+                unsigned int start = __builtin_ctz(pages) * MEMORY_PAGE_SIZE;
+                std::copy_n(memory_from.begin() + start, MEMORY_PAGE_SIZE, memory_to.begin() + start);
+        }
+        for (; rows != 0; rows &= rows - 1)
+        {
+                unsigned int start = __builtin_ctz(rows) * VIDEO_WIDTH;
+                std::copy_n(display_from.begin() + start, VIDEO_WIDTH, display_to.begin() + start);
+        }
+}
 
-        for (unsigned int i = 0; i < FONTSET_SIZE; ++i)
+// Bits of the memory pages a ROM of size bytes loads into
+static uint16_t rom_pages(size_t size)
+{
+        if (size == 0)
         {
-                memory[FONTSET_START_ADDRESS + i] = fontset[i];
+                return 0;
         }
+        unsigned int first = START_ADDRESS / MEMORY_PAGE_SIZE;
+        unsigned int last = (START_ADDRESS + size - 1) / MEMORY_PAGE_SIZE;
+        return ((2u << last) - 1) & ~((1u << first) - 1);
 }
 
-void Chip8::load_rom(std::string filename)
+Chip8::Chip8(const MemoryImage &image)
+    : memory(image.bytes), reset_from(&image), reset_image(image.id)
 {
-        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+}
 
-        if (file.is_open())
+void Chip8::reset(const MemoryImage &image)
+{
+        // Pages stored to and rows drawn since the last reset, wherever save
+        // and restore have folded them
+        uint16_t pages = unreset_pages | unsaved_pages;
+        uint32_t rows = unreset_rows | unsaved_rows;
+        if (reset_from != &image || reset_image != image.id)
         {
-                std::streampos size = file.tellg();
-                char *buffer = new char[size];
-                file.seekg(0, std::ios::beg);
-                file.read(buffer, size);
-                file.close();
-
-                for (long i = 0; i < size; ++i)
-                {
-                        memory[START_ADDRESS + i] = buffer[i];
-                }
-                delete[] buffer;
+                pages = 0xffffu;
         }
+        copy_changed(memory, image.bytes, display, BLANK_DISPLAY, pages, rows);
+        reset_from = &image;
+        reset_image = image.id;
+        unreset_pages = 0;
+        unreset_rows = 0;
+
+        v_registers.fill(0);
+        stack.fill(0);
+        keypad = 0;
+        pc = START_ADDRESS;
+        index = 0;
+        sound_timer = 0;
+        delay_timer = 0;
+        sp = 0;
+
+        dirty_rows = 0xffffffffu;
+        row_hashes.fill(0);
+        rolling_hash = 0;
+        key_wait = false;
+        key_unread = 0;
+        key_fresh = 0;
+        release_pending = 0;
+        dirty_pages = 0xffffu;
+        page_hashes.fill(0);
+        saved_to = nullptr;
+        unsaved_rows = 0;
+        unsaved_pages = 0;
+        ++display_writes;
+#ifdef CHIP8_VIP_TIMING
+        cycle_cost = 0;
+        frame_cycles = 0;
+        vblank_wait = false;
+#endif
 }
 
-void Chip8::dump_mem()
+// Reads at most MEMORY_SIZE - START_ADDRESS bytes of filename into out and
+// returns how many, or -1 if it cannot be opened
+static std::streamsize read_rom(const std::string &filename, uint8_t *out)
 {
-        for (int i{0}; auto &item : memory)
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
         {
-                std::bitset<8> converted(item);
-                std::cout << "Address 0x" << std::hex << i << ": ";
-                std::cout << std::hex << converted.to_ulong();
-                std::cout << "\n";
-                ++i;
+                return -1;
         }
+        file.read(reinterpret_cast<char *>(out), MEMORY_SIZE - START_ADDRESS);
+        return file.gcount();
+}
+
+static std::atomic<uint64_t> next_image_id{1};
+
+void MemoryImage::load_rom(const uint8_t *data, size_t size)
+{
+        size = std::min<size_t>(size, MEMORY_SIZE - START_ADDRESS);
+        std::copy(data, data + size, bytes.begin() + START_ADDRESS);
+        id = next_image_id.fetch_add(1, std::memory_order_relaxed);
 }
 
-void Chip8::dump_regs()
+bool MemoryImage::load_rom(std::string filename)
 {
-        std::cout << "\n";
-        for (int i{0}; auto &item : v_registers)
+        if (read_rom(filename, bytes.data() + START_ADDRESS) < 0)
         {
-                std::bitset<8> converted(item);
-                std::cout << "VRegister " << i << ": ";
-                std::cout << converted.to_ulong();
-                std::cout << "\n";
-                ++i;
+                return false;
         }
+        id = next_image_id.fetch_add(1, std::memory_order_relaxed);
+        return true;
 }
 
-void Chip8::dump_display()
+void Chip8::load_rom(std::string filename)
 {
-        std::cout << "\n";
-        for (int i{0}; auto &pixel : display)
+        std::streamsize size = read_rom(filename, memory.data() + START_ADDRESS);
+        if (size > 0)
         {
-                std::bitset<8> converted(pixel);
-                std::cout << converted.to_ulong();
-                if ((i + 1) % 64 == 0)
-                {
-                        std::cout << "\n";
-                }
-                ++i;
+                dirty_pages |= rom_pages(size);
+                unsaved_pages |= rom_pages(size);
         }
 }
 
+void Chip8::load_rom(const uint8_t *data, size_t size)
+{
+        size = std::min<size_t>(size, MEMORY_SIZE - START_ADDRESS);
+        std::copy(data, data + size, memory.begin() + START_ADDRESS);
+        dirty_pages |= rom_pages(size);
+        unsaved_pages |= rom_pages(size);
+}
+
+// Renders a capture and prints it with one write
+static void print_dump(const std::vector<uint8_t> &dump)
+{
+        std::string text;
+        format_state_dump(dump.data(), dump.size(), text);
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::fflush(stdout);
+}
+
+void Chip8::dump_mem() const
+{
+        StateDumper dumper;
+        print_dump(dumper.capture(*this, DUMP_MEMORY));
+}
+
+void Chip8::dump_regs() const
+{
+        StateDumper dumper;
+        print_dump(dumper.capture(*this, DUMP_REGS));
+}
+
+void Chip8::dump_display() const
+{
+        StateDumper dumper;
+        print_dump(dumper.capture(*this, DUMP_DISPLAY));
+}
+
 void Chip8::cycle()
 {
         // Fetch
-        uint16_t opcode = (memory[pc] << 8u) | memory[pc + 1];
+        uint16_t opcode = (memory[pc & ADDRESS_MASK] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
         // std::cout << "Fetching Op: " << std::hex << opcode << "\n";
+        if (coverage)
+        {
+                coverage->code.set(pc & ADDRESS_MASK);
+        }
         pc += 2;
 
-        // Decode/Execute
-        uint16_t addtl_op{};
-        uint8_t op = (opcode & 0xf000u) >> 12u;
-        uint8_t x = (opcode & 0x0f00u) >> 8u;
-        uint8_t y = (opcode & 0x00f0u) >> 4u;
-        uint8_t n = opcode & 0x000fu;
-        uint8_t kk = opcode & 0x00ffu;
-        uint16_t nnn = opcode & 0x0fffu;
-        if (op == 0x0)
-        {
-                addtl_op = opcode & 0xfu;
-                if (addtl_op == 0x0)
-                {
-                        op_00e0(x, y, n, kk, nnn);
-                }
-                else
-                {
-                        op_00ee(x, y, n, kk, nnn);
-                }
-        }
-        else if (op == 0x1)
+        // Decode/Execute, both generated from Isa::TABLE
+        Op op = isa_decode(opcode);
+        ISA_DISPATCH[static_cast<unsigned int>(op)](*this, (opcode & 0x0f00u) >> 8u, (opcode & 0x00f0u) >> 4u,
+                                                    opcode & 0x000fu, opcode & 0x00ffu, opcode & 0x0fffu);
+
+        retire(op, opcode);
+}
+
+// Per-instruction bookkeeping after the handler ran, shared with recompiled code
+void Chip8::retire(Op op, uint16_t opcode)
+{
+        count(counters.instructions);
+        if (input || release_pending)
         {
-                op_1nnn(x, y, n, kk, nnn);
+                apply_input();
         }
-        else if (op == 0x2)
+#ifdef CHIP8_VIP_TIMING
+        cycle_cost = vip_instruction_cycles(opcode, skipped);
+        skipped = false;
+        if (op == Op::OP_DXYN)
         {
-                op_2nnn(x, y, n, kk, nnn);
+                vblank_wait = true;
         }
-        else if (op == 0x3)
+#else
+        tick_timers();
+#endif
+}
+
+#ifdef CHIP8_VIP_TIMING
+void Chip8::run_frame()
+{
+        InstanceCounters flushed = counters;
+        // Cycles overspent by the last instruction of a field carry into the next
+        frame_cycles += VIP_CYCLES_PER_FRAME - VIP_INTERRUPT_CYCLES;
+        vblank_wait = false;
+
+        while (frame_cycles > 0 && !vblank_wait)
         {
-                op_3xkk(x, y, n, kk, nnn);
+                cycle();
+                frame_cycles -= cycle_cost;
         }
-        else if (op == 0x4)
+
+        // A draw idles the CPU until the next vertical interrupt
+        if (vblank_wait && frame_cycles > 0)
         {
-                op_4xkk(x, y, n, kk, nnn);
+                frame_cycles = 0;
         }
-        else if (op == 0x5)
+
+        tick_timers();
+        end_frame(flushed);
+}
+#else
+void Chip8::run_frame()
+{
+        InstanceCounters flushed = counters;
+        for (unsigned int i = 0; i < instructions_per_frame; ++i)
         {
-                op_5xy0(x, y, n, kk, nnn);
+                cycle();
         }
-        else if (op == 0x6)
+        end_frame(flushed);
+}
+#endif
+
+void Chip8::end_frame(InstanceCounters &flushed)
+{
+        age_keys();
+        count(counters.frames);
+        if (key_wait)
         {
-                op_6xkk(x, y, n, kk, nnn);
+                count(counters.idle_frames);
         }
-        else if (op == 0x7)
+        if (flush_metrics)
         {
-                op_7xkk(x, y, n, kk, nnn);
+                metric_flush(counters, flushed);
         }
-        else if (op == 0x8)
+}
+
+// Takes queued key events. A press shows up at once; a release of a key no
+// instruction has read yet waits until one does, or until the key aged past
+// a frame boundary, so a short tap is never lost between polls.
+void Chip8::apply_input()
+{
+        KeyEvent event;
+        uint64_t now = 0;
+        while (input && input->pop(event))
         {
-                addtl_op = opcode & 0xfu;
-                if (addtl_op == 0x0)
+                uint16_t bit = 1u << (event.key & 0xfu);
+                if (event.down)
                 {
-                        op_8xy0(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x1)
-                {
-                        op_8xy1(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x2)
-                {
-                        op_8xy2(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x3)
-                {
-                        op_8xy3(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x4)
-                {
-                        op_8xy4(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x5)
-                {
-                        op_8xy5(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x6)
-                {
-                        op_8xy6(x, y, n, kk, nnn);
+                        keypad |= bit;
+                        key_unread |= bit;
+                        key_fresh |= bit;
+                        release_pending &= ~bit;
+                        if (!now)
+                        {
+                                now = input_clock_ns();
+                        }
+                        input->applied(event, now);
                 }
-                else if (addtl_op == 0x7)
+                else if (key_unread & bit)
                 {
-                        op_8xy7(x, y, n, kk, nnn);
+                        release_pending |= bit;
                 }
-                else if (addtl_op == 0xe)
+                else
                 {
-                        op_8xye(x, y, n, kk, nnn);
+                        keypad &= ~bit;
                 }
         }
-        else if (op == 0x9)
-        {
-                op_9xy0(x, y, n, kk, nnn);
-        }
-        else if (op == 0xa)
-        {
-                op_annn(x, y, n, kk, nnn);
-        }
-        else if (op == 0xb)
-        {
-                op_bnnn(x, y, n, kk, nnn);
-        }
-        else if (op == 0xc)
-        {
-                op_cxkk(x, y, n, kk, nnn);
-        }
-        else if (op == 0xd)
+
+        uint16_t ready = release_pending & ~key_unread;
+        keypad &= ~ready;
+        release_pending &= ~ready;
+}
+
+void Chip8::keys_read(uint16_t keys)
+{
+        uint16_t first_reads = key_unread & keys;
+        if (!first_reads)
         {
-                op_dxyn(x, y, n, kk, nnn);
+                return;
         }
-        else if (op == 0xe)
+        key_unread &= ~keys;
+
+        if (input)
         {
-                addtl_op = opcode & 0xfu;
-                if (addtl_op == 0xe)
+                uint64_t now = input_clock_ns();
+                for (; first_reads != 0; first_reads &= first_reads - 1)
                 {
-                        op_ex9e(x, y, n, kk, nnn);
+                        input->observed(__builtin_ctz(first_reads), now);
                 }
-                else
+        }
+}
+
+void Chip8::age_keys()
+{
+        key_unread &= key_fresh;
+        key_fresh = 0;
+}
+
+void Chip8::seed(uint32_t value)
+{
+        rand_gen.seed(value);
+        rand_byte.reset();
+}
+
+void Chip8::save(Chip8Snapshot &snapshot)
+{
+        if (snapshot.owner != this || saved_to != &snapshot)
+        {
+                snapshot.owner = this;
+                saved_to = &snapshot;
+                unsaved_pages = 0xffffu;
+                unsaved_rows = 0xffffffffu;
+        }
+        copy_changed(snapshot.memory, memory, snapshot.display, display, unsaved_pages, unsaved_rows);
+        unreset_pages |= unsaved_pages;
+        unreset_rows |= unsaved_rows;
+        unsaved_pages = 0;
+        unsaved_rows = 0;
+
+        snapshot.v_registers = v_registers;
+        snapshot.stack = stack;
+        snapshot.pc = pc;
+        snapshot.index = index;
+        snapshot.sound_timer = sound_timer;
+        snapshot.delay_timer = delay_timer;
+        snapshot.sp = sp;
+        snapshot.keypad = keypad;
+        snapshot.rand_gen = rand_gen;
+        snapshot.rand_byte = rand_byte;
+        snapshot.dirty_rows = dirty_rows;
+        snapshot.row_hashes = row_hashes;
+        snapshot.rolling_hash = rolling_hash;
+        snapshot.key_wait = key_wait;
+        snapshot.key_unread = key_unread;
+        snapshot.key_fresh = key_fresh;
+        snapshot.release_pending = release_pending;
+        snapshot.dirty_pages = dirty_pages;
+        snapshot.page_hashes = page_hashes;
+#ifdef CHIP8_VIP_TIMING
+        snapshot.cycle_cost = cycle_cost;
+        snapshot.frame_cycles = frame_cycles;
+        snapshot.vblank_wait = vblank_wait;
+#endif
+}
+
+void Chip8::restore(Chip8Snapshot &snapshot)
+{
+        // A snapshot saved from another instance, or not the last one saved
+        // here, differs from us anywhere
+        if (snapshot.owner != this || saved_to != &snapshot)
+        {
+                snapshot.owner = this;
+                saved_to = &snapshot;
+                unsaved_pages = 0xffffu;
+                unsaved_rows = 0xffffffffu;
+        }
+        copy_changed(memory, snapshot.memory, display, snapshot.display, unsaved_pages, unsaved_rows);
+        display_writes += (unsaved_rows != 0);
+        unreset_pages |= unsaved_pages;
+        unreset_rows |= unsaved_rows;
+        unsaved_pages = 0;
+        unsaved_rows = 0;
+
+        v_registers = snapshot.v_registers;
+        stack = snapshot.stack;
+        pc = snapshot.pc;
+        index = snapshot.index;
+        sound_timer = snapshot.sound_timer;
+        delay_timer = snapshot.delay_timer;
+        sp = snapshot.sp;
+        keypad = snapshot.keypad;
+        rand_gen = snapshot.rand_gen;
+        rand_byte = snapshot.rand_byte;
+        dirty_rows = snapshot.dirty_rows;
+        row_hashes = snapshot.row_hashes;
+        rolling_hash = snapshot.rolling_hash;
+        key_wait = snapshot.key_wait;
+        key_unread = snapshot.key_unread;
+        key_fresh = snapshot.key_fresh;
+        release_pending = snapshot.release_pending;
+        dirty_pages = snapshot.dirty_pages;
+        page_hashes = snapshot.page_hashes;
+#ifdef CHIP8_VIP_TIMING
+        cycle_cost = snapshot.cycle_cost;
+        frame_cycles = snapshot.frame_cycles;
+        vblank_wait = snapshot.vblank_wait;
+#endif
+}
+
+// Rows are hashed as 64-bit masks so the result doesn't depend on the pixel format
+void Chip8::update_row_hashes()
+{
+        for (uint32_t rows = dirty_rows; rows != 0; rows &= rows - 1)
+        {
+                unsigned int row = __builtin_ctz(rows);
+                uint64_t bits = 0;
+                for (unsigned int col = 0; col < VIDEO_WIDTH; ++col)
                 {
-                        op_exa1(x, y, n, kk, nnn);
+                        if (display[row * VIDEO_WIDTH + col])
+                        {
+                                bits |= 1ull << col;
+                        }
                 }
+                row_hashes[row] = xxhash64(&bits, sizeof(bits), row);
         }
-        else if (op == 0xf)
+        dirty_rows = 0;
+}
+
+uint64_t Chip8::hash_frame()
+{
+        update_row_hashes();
+
+        uint64_t frame_hash = xxhash64(row_hashes.data(), sizeof(row_hashes));
+        rolling_hash = xxhash64(&frame_hash, sizeof(frame_hash), rolling_hash);
+        return frame_hash;
+}
+
+uint64_t Chip8::state_hash()
+{
+        update_row_hashes();
+
+        for (uint32_t pages = dirty_pages; pages != 0; pages &= pages - 1)
         {
-                addtl_op = opcode & 0xffu;
-                if (addtl_op == 0x07)
-                {
-                        op_fx07(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x0a)
-                {
-                        op_fx0a(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x15)
-                {
-                        op_fx15(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x18)
-                {
-                        op_fx18(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x1e)
-                {
-                        op_fx1e(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x29)
-                {
-                        op_fx29(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x33)
-                {
-                        op_fx33(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x55)
-                {
-                        op_fx55(x, y, n, kk, nnn);
-                }
-                else if (addtl_op == 0x65)
-                {
-                        op_fx65(x, y, n, kk, nnn);
-                }
+                unsigned int page = __builtin_ctz(pages);
+                page_hashes[page] = xxhash64(&memory[page * MEMORY_PAGE_SIZE], MEMORY_PAGE_SIZE, page);
         }
+        unsigned int rehashed = __builtin_popcount(dirty_pages);
+        metric_add(METRIC_HASH_PAGES_HASHED, rehashed);
+        metric_add(METRIC_HASH_PAGES_REUSED, page_hashes.size() - rehashed);
+        dirty_pages = 0;
 
+        struct
+        {
+                uint64_t memory_hash;
+                uint64_t display_hash;
+                std::array<uint16_t, STACK_LEVELS> stack;
+                std::array<uint8_t, REGISTER_COUNT> v_registers;
+                uint16_t pc;
+                uint16_t index;
+                uint8_t sp;
+                uint8_t delay_timer;
+                uint8_t sound_timer;
+                uint8_t padding;
+        } summary{};
+
+        summary.memory_hash = xxhash64(page_hashes.data(), sizeof(page_hashes));
+        summary.display_hash = xxhash64(row_hashes.data(), sizeof(row_hashes));
+        summary.stack = stack;
+        summary.v_registers = v_registers;
+        summary.pc = pc;
+        summary.index = index;
+        summary.sp = sp;
+        summary.delay_timer = delay_timer;
+        summary.sound_timer = sound_timer;
+        return xxhash64(&summary, sizeof(summary));
+}
+
+void Chip8::tick_timers()
+{
         if (delay_timer > 0)
         {
                 --delay_timer;
@@ -295,13 +512,16 @@ void Chip8::op_00e0(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
         {
                 value = 0;
         }
+        dirty_rows = 0xffffffffu;
+        unsaved_rows = 0xffffffffu;
+        ++display_writes;
 }
 
 // 00EE - RET
 void Chip8::op_00ee(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         --sp;
-        pc = stack[sp];
+        pc = stack[sp & STACK_MASK];
 }
 
 // 0nnn - SYS addr
@@ -318,7 +538,7 @@ void Chip8::op_1nnn(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 // 2nnn - CALL addr
 void Chip8::op_2nnn(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
-        stack[sp] = pc;
+        stack[sp & STACK_MASK] = pc;
         ++sp;
         pc = nnn;
 }
@@ -327,21 +547,21 @@ void Chip8::op_2nnn(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 void Chip8::op_3xkk(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         if (v_registers[x] == kk)
-                pc += 2;
+                skip_next();
 }
 
 // 4xkk - SNE Vx, byte
 void Chip8::op_4xkk(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         if (v_registers[x] != kk)
-                pc += 2;
+                skip_next();
 }
 
 // 5xy0 - SE Vx, Vy
 void Chip8::op_5xy0(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         if (v_registers[x] == v_registers[y])
-                pc += 2;
+                skip_next();
 }
 
 // 6xkk - LD Vx, byte
@@ -445,7 +665,7 @@ void Chip8::op_9xy0(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         if (v_registers[x] != v_registers[y])
         {
-                pc += 2;
+                skip_next();
         }
 }
 
@@ -473,11 +693,17 @@ void Chip8::op_dxyn(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
         uint8_t x_c = v_registers[x] % 64;
         uint8_t y_c = v_registers[y] % 32;
         v_registers[0xF] = 0u;
+        count(counters.draws);
         // std::cout << "drawing to " << +x_c << "," << +y_c << "\n";
-        for (unsigned int row = 0; row < n; ++row)
+        // Sprites clip at the right and bottom edges
+        for (unsigned int row = 0; row < n && y_c + row < VIDEO_HEIGHT; ++row)
         {
-                uint8_t spr_byte = memory[index + row];
-                for (unsigned int col = 0; col < 8; ++col)
+                uint8_t spr_byte = memory[(index + row) & ADDRESS_MASK];
+                if (coverage)
+                {
+                        coverage->data.set((index + row) & ADDRESS_MASK);
+                }
+                for (unsigned int col = 0; col < 8 && x_c + col < VIDEO_WIDTH; ++col)
                 {
                         uint8_t spr_pixel = spr_byte & (0x80u >> col);
                         uint32_t scr_pixel = display[((y_c + row) * 64) + (x_c + col)];
@@ -491,24 +717,38 @@ void Chip8::op_dxyn(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
                                 display[((y_c + row) * 64) + (x_c + col)] ^= 0xffffffff;
                         }
                 }
+                if (spr_byte)
+                {
+                        dirty_rows |= 1u << (y_c + row);
+                        unsaved_rows |= 1u << (y_c + row);
+                        ++display_writes;
+                }
+        }
+        if (v_registers[0xF])
+        {
+                count(counters.collisions);
         }
 }
 
 // Ex9E - SKP Vx
 void Chip8::op_ex9e(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
-        if (keypad[v_registers[x]])
+        uint16_t bit = 1u << (v_registers[x] & 0xfu);
+        keys_read(bit);
+        if (keypad & bit)
         {
-                pc += 2;
+                skip_next();
         }
 }
 
 // ExA1 - SKNP Vx
 void Chip8::op_exa1(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
-        if (!keypad[v_registers[x]])
+        uint16_t bit = 1u << (v_registers[x] & 0xfu);
+        keys_read(bit);
+        if (!(keypad & bit))
         {
-                pc += 2;
+                skip_next();
         }
 }
 
@@ -521,73 +761,17 @@ void Chip8::op_fx07(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 // Fx0A - LD Vx, K
 void Chip8::op_fx0a(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
-        if (keypad[0])
-        {
-                v_registers[x] = 0;
-        }
-        else if (keypad[1])
-        {
-                v_registers[x] = 1;
-        }
-        else if (keypad[2])
-        {
-                v_registers[x] = 2;
-        }
-        else if (keypad[3])
+        key_wait = false;
+        if (keypad)
         {
-                v_registers[x] = 3;
-        }
-        else if (keypad[4])
-        {
-                v_registers[x] = 4;
-        }
-        else if (keypad[5])
-        {
-                v_registers[x] = 5;
-        }
-        else if (keypad[6])
-        {
-                v_registers[x] = 6;
-        }
-        else if (keypad[7])
-        {
-                v_registers[x] = 7;
-        }
-        else if (keypad[8])
-        {
-                v_registers[x] = 8;
-        }
-        else if (keypad[9])
-        {
-                v_registers[x] = 9;
-        }
-        else if (keypad[10])
-        {
-                v_registers[x] = 10;
-        }
-        else if (keypad[11])
-        {
-                v_registers[x] = 11;
-        }
-        else if (keypad[12])
-        {
-                v_registers[x] = 12;
-        }
-        else if (keypad[13])
-        {
-                v_registers[x] = 13;
-        }
-        else if (keypad[14])
-        {
-                v_registers[x] = 14;
-        }
-        else if (keypad[15])
-        {
-                v_registers[x] = 15;
+                // Lowest held key wins
+                v_registers[x] = __builtin_ctz(keypad);
+                keys_read(keypad);
         }
         else
         {
                 pc -= 2;
+                key_wait = true;
         }
 }
 
@@ -621,15 +805,24 @@ void Chip8::op_fx33(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
         uint8_t value = v_registers[x];
 
         // Ones-place
-        memory[index + 2] = value % 10;
+        memory[(index + 2) & ADDRESS_MASK] = value % 10;
+        dirty_pages |= 1u << (((index + 2) & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
+        unsaved_pages |= 1u << (((index + 2) & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
         value /= 10;
 
         // Tens-place
-        memory[index + 1] = value % 10;
+        memory[(index + 1) & ADDRESS_MASK] = value % 10;
         value /= 10;
 
         // Hundreds-place
-        memory[index] = value % 10;
+        memory[index & ADDRESS_MASK] = value % 10;
+        dirty_pages |= 1u << ((index & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
+        unsaved_pages |= 1u << ((index & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
+
+        if (store_watch)
+        {
+                store_watch->on_store(index & ADDRESS_MASK, 3);
+        }
 }
 
 // Fx55 - LD [I], Vx
@@ -637,7 +830,14 @@ void Chip8::op_fx55(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         for (uint8_t i = 0; i <= x; ++i)
         {
-                memory[index + i] = v_registers[i];
+                memory[(index + i) & ADDRESS_MASK] = v_registers[i];
+                dirty_pages |= 1u << (((index + i) & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
+                unsaved_pages |= 1u << (((index + i) & ADDRESS_MASK) / MEMORY_PAGE_SIZE);
+        }
+
+        if (store_watch)
+        {
+                store_watch->on_store(index & ADDRESS_MASK, x + 1);
         }
 }
 
@@ -646,6 +846,10 @@ void Chip8::op_fx65(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
 {
         for (uint8_t i = 0; i <= x; ++i)
         {
-                v_registers[i] = memory[index + i];
+                v_registers[i] = memory[(index + i) & ADDRESS_MASK];
+                if (coverage)
+                {
+                        coverage->data.set((index + i) & ADDRESS_MASK);
+                }
         }
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <array>
 #include <string>
 #include <random>
+#include "decoder.h"
+#include "metrics.h"
 
 
 const unsigned int KEY_COUNT = 16;
@@ -12,25 +14,192 @@ const unsigned int REGISTER_COUNT = 16;
 const unsigned int STACK_LEVELS = 16;
 const unsigned int VIDEO_HEIGHT = 32;
 const unsigned int VIDEO_WIDTH = 64;
+const unsigned int START_ADDRESS = 0x200;
+const unsigned int MEMORY_PAGE_SIZE = 256;
+const unsigned int FONTSET_START_ADDRESS = 0x50;
+const unsigned int FONTSET_SIZE = 80;
+
+constexpr std::array<uint8_t, FONTSET_SIZE> FONTSET = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+// Memory as an instance starts with it: the font and, once loaded, a ROM.
+// Prepare one per ROM. Constructing a Chip8 from it copies it once; resetting
+// from the image last used copies back only the pages written since. Change
+// bytes only through load_rom, which gives the image a new id.
+struct MemoryImage
+{
+        constexpr MemoryImage()
+        {
+                for (unsigned int i = 0; i < FONTSET_SIZE; ++i)
+                {
+                        bytes[FONTSET_START_ADDRESS + i] = FONTSET[i];
+                }
+        }
+
+        // Copies at most MEMORY_SIZE - START_ADDRESS bytes to START_ADDRESS
+        void load_rom(const uint8_t *data, size_t size);
+        bool load_rom(std::string filename);
+
+        std::array<uint8_t, MEMORY_SIZE> bytes{};
+        uint64_t id{};             // 0 for the font alone, unique per load_rom otherwise
+};
+
+// Font only, built at compile time
+inline constexpr MemoryImage POWER_ON_IMAGE{};
+
+// Receives stores made by Fx33/Fx55, the only instructions that write memory
+class StoreWatch
+{
+public:
+        virtual ~StoreWatch() = default;
+        virtual void on_store(uint16_t address, uint16_t count) = 0;
+};
+
+struct Coverage;
+class KeyEventQueue;
+class Chip8;
+
+// Machine state saved by Chip8::save and put back by Chip8::restore. Keep
+// one per instance: saving into the snapshot last used with the same
+// instance copies only memory pages and display rows written since.
+class Chip8Snapshot
+{
+private:
+        friend class Chip8;
+
+        const Chip8 *owner{nullptr};
+        std::array<uint8_t, MEMORY_SIZE> memory{};
+        std::array<uint32_t, VIDEO_WIDTH * VIDEO_HEIGHT> display{};
+        std::array<uint8_t, REGISTER_COUNT> v_registers{};
+        std::array<uint16_t, STACK_LEVELS> stack{};
+        uint16_t pc{};
+        uint16_t index{};
+        uint8_t sound_timer{};
+        uint8_t delay_timer{};
+        uint8_t sp{};
+        uint16_t keypad{};
+        std::default_random_engine rand_gen;
+        std::uniform_int_distribution<uint8_t> rand_byte;
+        uint32_t dirty_rows{};
+        std::array<uint64_t, VIDEO_HEIGHT> row_hashes{};
+        uint64_t rolling_hash{};
+        bool key_wait{};
+        uint16_t key_unread{};
+        uint16_t key_fresh{};
+        uint16_t release_pending{};
+        uint16_t dirty_pages{};
+        std::array<uint64_t, MEMORY_SIZE / MEMORY_PAGE_SIZE> page_hashes{};
+#ifdef CHIP8_VIP_TIMING
+        uint32_t cycle_cost{};
+        int32_t frame_cycles{};
+        bool vblank_wait{};
+#endif
+};
 
 class Chip8
 {
 
 
 public:
-        Chip8();
-
+        // Every instance starts with the same RNG seed; see seed()
+        Chip8() : Chip8(POWER_ON_IMAGE) {}
+        explicit Chip8(const MemoryImage &image);
+
+        // Back to the power-on state with no ROM loaded, or with image as
+        // memory; the RNG keeps its state. Only memory pages and display
+        // rows written since the last reset from the same image are put
+        // back, so code that writes display directly must clear it itself.
+        void reset() { reset(POWER_ON_IMAGE); }
+        void reset(const MemoryImage &image);
         void load_rom(std::string filename);
-        void dump_mem();
-        void dump_display();
-        void dump_regs();
+        // Copies at most MEMORY_SIZE - START_ADDRESS bytes to START_ADDRESS
+        void load_rom(const uint8_t *data, size_t size);
+        // Readable dumps on stdout, see StateDumper for the binary form
+        void dump_mem() const;
+        void dump_display() const;
+        void dump_regs() const;
         void cycle();
+        // Runs one 60 Hz frame: a VIP field of machine cycles with
+        // CHIP8_VIP_TIMING, otherwise instructions_per_frame cycles
+        void run_frame();
+        void seed(uint32_t value);
+        // In-place save and rollback of everything but the pointers above and
+        // counters, for running frames speculatively. Code that writes
+        // display directly must not rely on restore() putting it back.
+        void save(Chip8Snapshot &snapshot);
+        void restore(Chip8Snapshot &snapshot);
+        // Lets keys tapped and released before any instruction read them go
+        // up. run_frame() calls it; loops driving cycle() call it at 60 Hz.
+        void age_keys();
+
+        // Folds rows drawn since the last call into the frame and stream
+        // hashes and returns the frame hash. Call once per frame boundary.
+        uint64_t hash_frame();
+        uint64_t stream_hash() const { return rolling_hash; }
+
+        // Hash of registers, stack, timers, memory and display, kept cheap by
+        // rehashing only memory pages and display rows written since the last
+        // call. RNG state and keypad are not included.
+        uint64_t state_hash();
+
+        // The last instruction was an Fx0A still waiting for a key
+        bool waiting_for_key() const { return key_wait; }
+
+        // Changes whenever Dxyn, 00E0, reset or restore may have changed the
+        // display, so consumers can skip frames that drew nothing
+        uint32_t display_version() const { return display_writes; }
 
         std::array<uint32_t, 2048> display{};
-        std::array<uint8_t, KEY_COUNT> keypad{};
+        uint16_t keypad{};                   // bit k is set while key k is held
+        KeyEventQueue *input{nullptr};       // drained at every instruction boundary
+        InstanceCounters counters;           // run_frame() also adds them to the process metrics
+        bool flush_metrics{true};            // false keeps run_frame() out of the process metrics
+        unsigned int instructions_per_frame{10};
+        StoreWatch *store_watch{nullptr};
+        Coverage *coverage{nullptr};
 
 
 private:
+        // Code emitted by chip8-recompile calls the handlers directly
+        template <typename Program>
+        friend struct Recompiled;
+        friend class StateDumper;
+        friend class Debugger;
+        friend class Explorer;
+        friend class ShmExporter;
+        friend class Differential;
+        friend struct Isa;
+
+        void retire(Op op, uint16_t opcode);
+        // Steps over the next instruction for a taken skip
+        void skip_next()
+        {
+                pc += 2;
+#ifdef CHIP8_VIP_TIMING
+                skipped = true;
+#endif
+        }
+        void tick_timers();
+        void apply_input();
+        void end_frame(InstanceCounters &flushed);
+        void keys_read(uint16_t keys);
+        void update_row_hashes();
 
         //Instructions
 
@@ -143,18 +312,42 @@ private:
         void op_fx65(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn);
 
         std::array<uint8_t, 16> v_registers{};
-        std::array<uint8_t, 4096> memory{};
+        std::array<uint8_t, 4096> memory;
         std::array<uint16_t, 16> stack{};
-        uint16_t pc;
-        uint16_t index;
-        uint8_t sound_timer;
-        uint8_t delay_timer;
-        uint8_t sp;
-        std::array<uint8_t, 80> fontset{};
+        uint16_t pc{START_ADDRESS};
+        uint16_t index{};
+        uint8_t sound_timer{};
+        uint8_t delay_timer{};
+        uint8_t sp{};
 
         std::default_random_engine rand_gen;
 	std::uniform_int_distribution<uint8_t> rand_byte;
 
+        uint32_t dirty_rows{0xffffffffu};    // display rows changed since hash_frame
+        std::array<uint64_t, VIDEO_HEIGHT> row_hashes{};
+        uint64_t rolling_hash{};
+        bool key_wait{};
+        uint16_t key_unread{};               // pressed, not yet read by Ex9E/ExA1/Fx0A
+        uint16_t key_fresh{};                // pressed since the last age_keys
+        uint16_t release_pending{};          // released, held until read or aged
+        uint16_t dirty_pages{0xffffu};       // MEMORY_PAGE_SIZE pages stored to since state_hash
+        std::array<uint64_t, MEMORY_SIZE / MEMORY_PAGE_SIZE> page_hashes{};
+        const Chip8Snapshot *saved_to{nullptr};
+        uint32_t unsaved_rows{};             // display rows changed since save/restore with saved_to
+        uint32_t display_writes{};
+        uint16_t unsaved_pages{};            // memory pages stored to since then
+        const MemoryImage *reset_from{nullptr};
+        uint64_t reset_image{};              // id of reset_from when it was applied
+        uint32_t unreset_rows{};             // with unsaved_rows, display rows drawn since then
+        uint16_t unreset_pages{};            // with unsaved_pages, memory pages stored to since then
+
+#ifdef CHIP8_VIP_TIMING
+        uint32_t cycle_cost{};     // machine cycles charged by the last instruction
+        int32_t frame_cycles{};    // machine cycles left in the current field
+        bool vblank_wait{};        // Dxyn waits for the next field before continuing
+        bool skipped{};            // the current instruction was a taken skip
+#endif
+
 
 
 };
\ No newline at end of file
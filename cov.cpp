@@ -0,0 +1,69 @@
+#include "coverage.h"
+#include "input_script.h"
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char ** argv)
+{
+	bool running = argc >= 2 && std::strcmp(argv[1], "run") == 0;
+	bool reporting = argc >= 2 && std::strcmp(argv[1], "report") == 0;
+
+	if (!(running && (argc == 5 || argc == 6)) && !(reporting && argc == 5)) {
+		std::cerr << "Usage: " << argv[0] << " run <ROM> <Coverage> <Frames> [Input]\n";
+		std::cerr << "       " << argv[0] << " report <ROM> <Coverage> <lcov|json>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	char const *rom_file_name = argv[2];
+	char const *coverage_file_name = argv[3];
+
+	// Runs accumulate into an existing coverage file
+	Coverage coverage;
+	bool have_coverage = coverage.load(coverage_file_name);
+
+	if (running) {
+		InputScript input;
+		if (argc == 6 && !input.load(argv[5])) {
+			std::cerr << "Could not read " << argv[5] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		Coverage run;
+		Chip8 chip8;
+		chip8.seed(1);
+		chip8.load_rom(rom_file_name);
+		chip8.coverage = &run;
+
+		unsigned int frames = std::stoi(argv[4]);
+		for (unsigned int frame = 0; frame < frames; ++frame) {
+			input.apply(frame, chip8);
+			chip8.run_frame();
+		}
+
+		coverage.merge(run);
+		if (!coverage.save(coverage_file_name)) {
+			std::cerr << "Could not write " << coverage_file_name << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return 0;
+	}
+
+	if (!have_coverage) {
+		std::cerr << "Could not read " << coverage_file_name << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	RomAnalysis analysis;
+	if (!analysis.load_rom(rom_file_name)) {
+		std::cerr << "Could not read " << rom_file_name << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	if (std::strcmp(argv[4], "json") == 0) {
+		std::cout << coverage.json(rom_file_name, analysis.map, analysis.rom_size);
+	}
+	else {
+		std::cout << coverage.lcov(rom_file_name, analysis.map, analysis.rom_size);
+	}
+	return 0;
+}
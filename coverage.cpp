@@ -0,0 +1,162 @@
+#include "coverage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+const char COVERAGE_MAGIC[4] = {'C', '8', 'C', 'V'};
+const uint8_t COVERAGE_VERSION = 1;
+
+void Coverage::merge(const Coverage &other)
+{
+        code |= other.code;
+        data |= other.data;
+}
+
+static void write_bits(std::ofstream &file, const std::bitset<MEMORY_SIZE> &bits)
+{
+        for (unsigned int i = 0; i < MEMORY_SIZE; i += 8)
+        {
+                uint8_t byte = 0;
+                for (unsigned int bit = 0; bit < 8; ++bit)
+                {
+                        byte |= bits[i + bit] << bit;
+                }
+                file.put(byte);
+        }
+}
+
+static void read_bits(std::ifstream &file, std::bitset<MEMORY_SIZE> &bits)
+{
+        for (unsigned int i = 0; i < MEMORY_SIZE; i += 8)
+        {
+                uint8_t byte = file.get();
+                for (unsigned int bit = 0; bit < 8; ++bit)
+                {
+                        bits[i + bit] = (byte >> bit) & 1u;
+                }
+        }
+}
+
+bool Coverage::save(std::string filename) const
+{
+        std::ofstream file(filename, std::ios::binary);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        file.write(COVERAGE_MAGIC, sizeof(COVERAGE_MAGIC));
+        file.put(COVERAGE_VERSION);
+        write_bits(file, code);
+        write_bits(file, data);
+        return file.good();
+}
+
+bool Coverage::load(std::string filename)
+{
+        std::ifstream file(filename, std::ios::binary);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        char magic[sizeof(COVERAGE_MAGIC)];
+        file.read(magic, sizeof(magic));
+        if (!file || !std::equal(magic, magic + sizeof(magic), COVERAGE_MAGIC) || file.get() != COVERAGE_VERSION)
+        {
+                return false;
+        }
+
+        read_bits(file, code);
+        read_bits(file, data);
+        return file.good();
+}
+
+std::string Coverage::lcov(std::string rom_name, const CodeMap &static_code, unsigned int rom_size) const
+{
+        std::string text = "TN:chip8\nSF:" + rom_name + "\n";
+        unsigned int found = 0;
+        unsigned int hit = 0;
+        char line[32];
+
+        // lcov has no notion of addresses, so each instruction address is a "line"
+        for (unsigned int addr = START_ADDRESS; addr < START_ADDRESS + rom_size && addr < MEMORY_SIZE; ++addr)
+        {
+                if (!(static_code[addr] & MAP_CODE) && !code[addr])
+                {
+                        continue;
+                }
+                std::snprintf(line, sizeof(line), "DA:%u,%u\n", addr, code[addr] ? 1u : 0u);
+                text += line;
+                ++found;
+                hit += code[addr];
+        }
+
+        text += "LF:" + std::to_string(found) + "\nLH:" + std::to_string(hit) + "\nend_of_record\n";
+        return text;
+}
+
+// Appends [first, last] byte ranges of set bits inside the ROM as a JSON array.
+// Instructions mark only their first byte, so code runs use a stride of 2.
+static void append_ranges(std::string &text, const std::bitset<MEMORY_SIZE> &bits, unsigned int rom_size,
+                          unsigned int stride)
+{
+        char range[32];
+        bool first = true;
+        unsigned int end = START_ADDRESS + rom_size;
+
+        text += '[';
+        for (unsigned int addr = START_ADDRESS; addr < end && addr < MEMORY_SIZE; ++addr)
+        {
+                if (!bits[addr])
+                {
+                        continue;
+                }
+                unsigned int last = addr;
+                while (last + stride < end && last + stride < MEMORY_SIZE && bits[last + stride])
+                {
+                        last += stride;
+                }
+                std::snprintf(range, sizeof(range), "%s[%u,%u]", first ? "" : ",", addr, last + stride - 1);
+                text += range;
+                first = false;
+                addr = last;
+        }
+        text += ']';
+}
+
+std::string Coverage::json(std::string rom_name, const CodeMap &static_code, unsigned int rom_size) const
+{
+        unsigned int reachable = 0;
+        unsigned int executed = 0;
+        unsigned int data_read = 0;
+        for (unsigned int addr = START_ADDRESS; addr < START_ADDRESS + rom_size && addr < MEMORY_SIZE; ++addr)
+        {
+                reachable += (static_code[addr] & MAP_CODE) ? 1 : 0;
+                executed += code[addr];
+                data_read += data[addr];
+        }
+
+        std::string text = "{\"rom\":\"";
+        for (char ch : rom_name)
+        {
+                if (ch == '"' || ch == '\\')
+                {
+                        text += '\\';
+                }
+                text += ch;
+        }
+        text += "\",\"size\":" + std::to_string(rom_size);
+        text += ",\"static_instructions\":" + std::to_string(reachable);
+        text += ",\"executed_instructions\":" + std::to_string(executed);
+        text += ",\"data_bytes_read\":" + std::to_string(data_read);
+        text += ",\"code\":";
+        append_ranges(text, code, rom_size, 2);
+        text += ",\"data\":";
+        append_ranges(text, data, rom_size, 1);
+        text += "}\n";
+        return text;
+}
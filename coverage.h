@@ -0,0 +1,25 @@
+#pragma once
+
+#include "analyzer.h"
+#include <bitset>
+#include <string>
+
+// Addresses fetched as instructions and read as data through I (Dxyn, Fx65).
+// Point Chip8::coverage at one to record; bitmaps from separate runs merge
+// with merge().
+struct Coverage
+{
+        std::bitset<MEMORY_SIZE> code;
+        std::bitset<MEMORY_SIZE> data;
+
+        void merge(const Coverage &other);
+
+        // Binary form: "C8CV", version byte, code bitmap, data bitmap
+        bool load(std::string filename);
+        bool save(std::string filename) const;
+
+        // Reports over [START_ADDRESS, START_ADDRESS + rom_size). Instructions
+        // the static analyzer can reach count as coverable lines.
+        std::string lcov(std::string rom_name, const CodeMap &static_code, unsigned int rom_size) const;
+        std::string json(std::string rom_name, const CodeMap &static_code, unsigned int rom_size) const;
+};
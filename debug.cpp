@@ -0,0 +1,45 @@
+#include "debugger.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> [Script]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	Chip8 chip8;
+	chip8.load_rom(argv[1]);
+	Debugger debugger(chip8);
+
+	std::ifstream script;
+	if (argc == 3) {
+		script.open(argv[2]);
+		if (!script.is_open()) {
+			std::cerr << "Could not read " << argv[2] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	std::istream &input = (argc == 3) ? static_cast<std::istream &>(script) : std::cin;
+	bool interactive = argc == 2;
+
+	std::string line;
+	while (true) {
+		if (interactive) {
+			std::cout << "(chip8) " << std::flush;
+		}
+		if (!std::getline(input, line)) {
+			break;
+		}
+
+		std::string text;
+		bool keep_going = debugger.command(line, text);
+		std::fwrite(text.data(), 1, text.size(), stdout);
+		if (!keep_going) {
+			break;
+		}
+	}
+	return 0;
+}
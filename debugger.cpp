@@ -0,0 +1,492 @@
+#include "debugger.h"
+#include "isa.h"
+#include "state_dump.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+
+const uint64_t DEFAULT_CONTINUE_LIMIT = 100000000;
+const unsigned int MAX_BLOCK_LENGTH = 255;
+
+Debugger::Debugger(Chip8 &chip8)
+    : chip8(chip8)
+{
+        chip8.store_watch = this;
+}
+
+Debugger::~Debugger()
+{
+        chip8.store_watch = nullptr;
+}
+
+void Debugger::add_breakpoint(uint16_t address)
+{
+        breakpoints.set(address % MEMORY_SIZE);
+        conditions.erase(address % MEMORY_SIZE);
+        blocks.fill(UNKNOWN);
+}
+
+void Debugger::add_breakpoint(uint16_t address, BreakCondition condition)
+{
+        add_breakpoint(address);
+        conditions[address % MEMORY_SIZE] = condition;
+}
+
+void Debugger::remove_breakpoint(uint16_t address)
+{
+        breakpoints.reset(address % MEMORY_SIZE);
+        conditions.erase(address % MEMORY_SIZE);
+        blocks.fill(UNKNOWN);
+}
+
+void Debugger::add_watchpoint(uint16_t start, uint16_t end)
+{
+        watch_ranges.emplace_back(start, end);
+        for (unsigned int addr = start; addr <= end && addr < MEMORY_SIZE; ++addr)
+        {
+                watched.set(addr);
+        }
+}
+
+void Debugger::remove_watchpoint(uint16_t start)
+{
+        std::erase_if(watch_ranges, [start](auto const &range) { return range.first == start; });
+        watched.reset();
+        for (auto const &[from, to] : watch_ranges)
+        {
+                for (unsigned int addr = from; addr <= to && addr < MEMORY_SIZE; ++addr)
+                {
+                        watched.set(addr);
+                }
+        }
+}
+
+bool Debugger::load_map(std::string filename)
+{
+        has_map = load_code_map(filename, code_map);
+        return has_map;
+}
+
+void Debugger::on_store(uint16_t address, uint16_t count)
+{
+        for (unsigned int i = 0; i < count; ++i)
+        {
+                if (watched[(address + i) % MEMORY_SIZE])
+                {
+                        watch_hit = true;
+                }
+        }
+
+        // The store may have rewritten code. Blocks end at 0xfff, except that
+        // one starting at an odd address reads byte 0 as its last operand.
+        unsigned int from = address % MEMORY_SIZE;
+        unsigned int to = from + count;
+        invalidate_blocks(from, std::min<unsigned int>(to, MEMORY_SIZE));
+        if (to > MEMORY_SIZE)
+        {
+                invalidate_blocks(0, to - MEMORY_SIZE);
+        }
+        if (from == 0 || to > MEMORY_SIZE)
+        {
+                invalidate_blocks(MEMORY_SIZE, MEMORY_SIZE + 1);
+        }
+}
+
+// Forgets cached blocks holding any byte in [from, to)
+void Debugger::invalidate_blocks(unsigned int from, unsigned int to)
+{
+        unsigned int reach = 2 * longest_block;
+        unsigned int first = (from + 1 > reach) ? from + 1 - reach : 0;
+        for (unsigned int start = first; start < std::min<unsigned int>(to, MEMORY_SIZE); ++start)
+        {
+                if (blocks[start] != UNKNOWN && start + 2 * block_lengths[start] > from)
+                {
+                        blocks[start] = UNKNOWN;
+                }
+        }
+}
+
+// Scans forward from start to the end of its basic block, caching the result
+Debugger::BlockState Debugger::block_state(uint16_t start)
+{
+        if (blocks[start] != UNKNOWN)
+        {
+                return blocks[start];
+        }
+
+        BlockState state = CLEAN;
+        unsigned int length = 0;
+        unsigned int addr = start;
+        while (true)
+        {
+                ++length;
+                if (breakpoints[addr])
+                {
+                        state = HAS_BREAKPOINT;
+                }
+
+                Instruction ins = decode((chip8.memory[addr] << 8u) | chip8.memory[(addr + 1) % MEMORY_SIZE]);
+                if (ends_block(ins.op) || ins.op == Op::OP_FX0A || length == MAX_BLOCK_LENGTH || addr + 2 >= MEMORY_SIZE)
+                {
+                        break;
+                }
+                addr += 2;
+        }
+
+        blocks[start] = state;
+        block_lengths[start] = length;
+        longest_block = std::max(longest_block, length);
+        return state;
+}
+
+bool Debugger::breakpoint_hit(uint16_t address) const
+{
+        if (!breakpoints[address])
+        {
+                return false;
+        }
+
+        auto condition = conditions.find(address);
+        return condition == conditions.end() || evaluate(condition->second);
+}
+
+bool Debugger::evaluate(const BreakCondition &condition) const
+{
+        uint16_t actual = 0;
+        switch (condition.source)
+        {
+        case BreakCondition::V:
+                actual = chip8.v_registers[condition.reg & 0xfu];
+                break;
+        case BreakCondition::I:
+                actual = chip8.index;
+                break;
+        case BreakCondition::DT:
+                actual = chip8.delay_timer;
+                break;
+        case BreakCondition::ST:
+                actual = chip8.sound_timer;
+                break;
+        case BreakCondition::SP:
+                actual = chip8.sp;
+                break;
+        }
+
+        switch (condition.compare)
+        {
+        case BreakCondition::EQ:
+                return actual == condition.value;
+        case BreakCondition::NE:
+                return actual != condition.value;
+        case BreakCondition::LT:
+                return actual < condition.value;
+        case BreakCondition::GT:
+                return actual > condition.value;
+        case BreakCondition::LE:
+                return actual <= condition.value;
+        case BreakCondition::GE:
+                return actual >= condition.value;
+        }
+        return false;
+}
+
+StopReason Debugger::run(uint64_t count)
+{
+        uint64_t end = executed + count;
+        bool first = true;
+        watch_hit = false;
+
+        while (executed < end)
+        {
+                uint16_t pc = chip8.pc % MEMORY_SIZE;
+
+                if (block_state(pc) == CLEAN)
+                {
+                        // No breakpoint ahead until the block ends
+                        unsigned int length = block_lengths[pc];
+                        for (unsigned int i = 0; i < length && executed < end; ++i)
+                        {
+                                stopped_at = chip8.pc;
+                                uint16_t next = chip8.pc + 2;
+                                chip8.cycle();
+                                ++executed;
+                                if (watch_hit)
+                                {
+                                        return StopReason::WATCHPOINT;
+                                }
+                                if (chip8.pc != next)
+                                {
+                                        break;
+                                }
+                        }
+                }
+                else
+                {
+                        if (!first && breakpoint_hit(pc))
+                        {
+                                stopped_at = pc;
+                                return StopReason::BREAKPOINT;
+                        }
+                        stopped_at = pc;
+                        chip8.cycle();
+                        ++executed;
+                        if (watch_hit)
+                        {
+                                return StopReason::WATCHPOINT;
+                        }
+                }
+                first = false;
+        }
+
+        stopped_at = chip8.pc;
+        return StopReason::LIMIT;
+}
+
+void Debugger::describe_stop(StopReason reason, std::string &text) const
+{
+        char line[96];
+        if (reason == StopReason::BREAKPOINT)
+        {
+                std::snprintf(line, sizeof(line), "breakpoint at %03x", stopped_at);
+        }
+        else if (reason == StopReason::WATCHPOINT)
+        {
+                std::snprintf(line, sizeof(line), "watchpoint hit by store at %03x, pc %03x", stopped_at, chip8.pc);
+        }
+        else
+        {
+                std::snprintf(line, sizeof(line), "stopped at %03x", chip8.pc);
+        }
+        text += line;
+        text += " after " + std::to_string(executed) + " instructions\n";
+}
+
+// count lines from from, one per instruction the map marks as code and one
+// per other byte, so data never shifts the instructions after it
+void Debugger::disassemble_mapped(uint16_t from, unsigned long count, std::string &text) const
+{
+        char line[64];
+        unsigned int addr = from % MEMORY_SIZE;
+        for (unsigned long i = 0; i < count && addr < MEMORY_SIZE; ++i)
+        {
+                if ((code_map[addr] & MAP_CODE) && addr + 1 < MEMORY_SIZE)
+                {
+                        disassemble(&chip8.memory[addr], 2, addr, text);
+                        addr += 2;
+                }
+                else
+                {
+                        std::snprintf(line, sizeof(line), "%03x  %02x    .byte 0x%02x%s\n", addr, chip8.memory[addr],
+                                      chip8.memory[addr], (code_map[addr] & MAP_DATA) ? "  ; data" : "");
+                        text += line;
+                        ++addr;
+                }
+        }
+}
+
+static bool parse_number(const std::string &word, unsigned long &value)
+{
+        try
+        {
+                size_t used = 0;
+                value = std::stoul(word, &used, 0);
+                return used == word.size();
+        }
+        catch (const std::exception &)
+        {
+                return false;
+        }
+}
+
+// Parses "<reg> <op> <value>", e.g. "v3 == 5" or "i >= 0x300"
+static bool parse_condition(std::istringstream &words, BreakCondition &condition)
+{
+        std::string reg, compare, value_word;
+        unsigned long value = 0;
+        if (!(words >> reg >> compare >> value_word) || !parse_number(value_word, value))
+        {
+                return false;
+        }
+
+        if (reg.size() == 2 && (reg[0] == 'v' || reg[0] == 'V') && std::isxdigit(static_cast<unsigned char>(reg[1])))
+        {
+                condition.source = BreakCondition::V;
+                condition.reg = std::stoul(reg.substr(1), nullptr, 16);
+        }
+        else if (reg == "i" || reg == "I")
+        {
+                condition.source = BreakCondition::I;
+        }
+        else if (reg == "dt")
+        {
+                condition.source = BreakCondition::DT;
+        }
+        else if (reg == "st")
+        {
+                condition.source = BreakCondition::ST;
+        }
+        else if (reg == "sp")
+        {
+                condition.source = BreakCondition::SP;
+        }
+        else
+        {
+                return false;
+        }
+
+        static const std::pair<const char *, BreakCondition::Compare> COMPARES[] = {
+            {"==", BreakCondition::EQ}, {"!=", BreakCondition::NE}, {"<", BreakCondition::LT},
+            {">", BreakCondition::GT},  {"<=", BreakCondition::LE}, {">=", BreakCondition::GE},
+        };
+        for (auto const &[name, kind] : COMPARES)
+        {
+                if (compare == name)
+                {
+                        condition.compare = kind;
+                        condition.value = value;
+                        return true;
+                }
+        }
+        return false;
+}
+
+bool Debugger::command(const std::string &line, std::string &text)
+{
+        std::istringstream words(line);
+        std::string verb;
+        if (!(words >> verb) || verb[0] == '#')
+        {
+                return true;
+        }
+
+        std::string first, second;
+        unsigned long a = 0, b = 0;
+        bool has_a = static_cast<bool>(words >> first) && parse_number(first, a);
+
+        if (verb == "quit" || verb == "q")
+        {
+                return false;
+        }
+        else if ((verb == "break" || verb == "b") && has_a)
+        {
+                std::string keyword;
+                if (words >> keyword)
+                {
+                        BreakCondition condition{};
+                        if (keyword != "if" || !parse_condition(words, condition))
+                        {
+                                text += "usage: break <addr> [if <v0-vf|i|dt|st|sp> <op> <value>]\n";
+                                return true;
+                        }
+                        add_breakpoint(a, condition);
+                }
+                else
+                {
+                        add_breakpoint(a);
+                }
+                if (has_map && !(code_map[a % MEMORY_SIZE] & MAP_CODE))
+                {
+                        text += "note: the code map has no instruction at " + first + "\n";
+                }
+        }
+        else if (verb == "delete" && has_a)
+        {
+                remove_breakpoint(a);
+        }
+        else if (verb == "watch" && has_a)
+        {
+                if (!(words >> second) || !parse_number(second, b))
+                {
+                        b = a;
+                }
+                add_watchpoint(a, b);
+        }
+        else if (verb == "unwatch" && has_a)
+        {
+                remove_watchpoint(a);
+        }
+        else if (verb == "continue" || verb == "c" || verb == "step" || verb == "s")
+        {
+                uint64_t count = (verb[0] == 'c') ? DEFAULT_CONTINUE_LIMIT : 1;
+                if (has_a)
+                {
+                        count = a;
+                }
+                describe_stop(run(count), text);
+        }
+        else if (verb == "regs")
+        {
+                StateDumper dumper;
+                auto const &dump = dumper.capture(chip8, DUMP_REGS);
+                format_state_dump(dump.data(), dump.size(), text);
+        }
+        else if (verb == "mem" && has_a)
+        {
+                if (!(words >> second) || !parse_number(second, b))
+                {
+                        b = 16;
+                }
+                StateDumper dumper;
+                auto const &dump = dumper.capture(chip8, DUMP_MEMORY, a, b);
+                format_state_dump(dump.data(), dump.size(), text);
+        }
+        else if (verb == "disas")
+        {
+                uint16_t from = has_a ? a : chip8.pc;
+                if (!(words >> second) || !parse_number(second, b))
+                {
+                        b = 10;
+                }
+                if (has_map)
+                {
+                        disassemble_mapped(from, b, text);
+                        return true;
+                }
+                std::vector<uint8_t> code;
+                for (unsigned long i = 0; i < 2 * b; ++i)
+                {
+                        code.push_back(chip8.memory[(from + i) % MEMORY_SIZE]);
+                }
+                disassemble(code.data(), code.size(), from, text);
+        }
+        else if (verb == "map" && !first.empty())
+        {
+                if (!load_map(first))
+                {
+                        text += "could not read code map " + first + "\n";
+                }
+        }
+        else if (verb == "display")
+        {
+                StateDumper dumper;
+                auto const &dump = dumper.capture(chip8, DUMP_DISPLAY);
+                format_state_dump(dump.data(), dump.size(), text);
+        }
+        else if (verb == "info")
+        {
+                char entry[64];
+                for (unsigned int addr = 0; addr < MEMORY_SIZE; ++addr)
+                {
+                        if (breakpoints[addr])
+                        {
+                                std::snprintf(entry, sizeof(entry), "break %03x%s\n", addr,
+                                              conditions.count(addr) ? " (conditional)" : "");
+                                text += entry;
+                        }
+                }
+                for (auto const &[from, to] : watch_ranges)
+                {
+                        std::snprintf(entry, sizeof(entry), "watch %03x-%03x\n", from, to);
+                        text += entry;
+                }
+        }
+        else
+        {
+                text += "commands: break <addr> [if <reg> <op> <value>], delete <addr>, watch <start> [end],\n"
+                        "          unwatch <start>, continue [n], step [n], regs, mem <addr> [len], disas [addr] [count],\n"
+                        "          display, info, map <file>, quit\n";
+        }
+        return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "analyzer.h"
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+
+enum class StopReason
+{
+        LIMIT,          // ran the requested number of instructions
+        BREAKPOINT,
+        WATCHPOINT,
+};
+
+// Register test attached to a breakpoint, e.g. "v3 == 5"
+struct BreakCondition
+{
+        enum Source { V, I, DT, ST, SP } source;
+        uint8_t reg;        // V register number
+        enum Compare { EQ, NE, LT, GT, LE, GE } compare;
+        uint16_t value;
+};
+
+// Breakpoints and write watchpoints for one Chip8.
+//
+// PC breakpoints live in a bitmap. The debugger only consults it when
+// entering a basic block: blocks without a breakpoint run straight through
+// Chip8::cycle. Watchpoints ride on Chip8::store_watch, which is only called
+// from Fx33/Fx55. A Chip8 with no debugger attached pays one null check per
+// store and nothing else.
+//
+// With a code map from chip8-analyze loaded, disassembly follows the map's
+// instruction boundaries and shows data as bytes, and breakpoints on
+// addresses the analyzer never reached as code are flagged.
+class Debugger : public StoreWatch
+{
+public:
+        explicit Debugger(Chip8 &chip8);
+        ~Debugger();
+
+        void add_breakpoint(uint16_t address);
+        void add_breakpoint(uint16_t address, BreakCondition condition);
+        void remove_breakpoint(uint16_t address);
+        void add_watchpoint(uint16_t start, uint16_t end);
+        void remove_watchpoint(uint16_t start);
+        // Loads a map written by chip8-analyze, see load_code_map
+        bool load_map(std::string filename);
+
+        // Runs until a breakpoint or watchpoint is hit or count instructions ran.
+        // A breakpoint at the current pc does not stop the first instruction.
+        StopReason run(uint64_t count);
+
+        // Executes one command line, appending its output to text.
+        // Returns false for "quit".
+        bool command(const std::string &line, std::string &text);
+
+        uint16_t stop_address() const { return stopped_at; }
+        uint64_t instructions() const { return executed; }
+
+        void on_store(uint16_t address, uint16_t count) override;
+
+private:
+        enum BlockState : uint8_t { UNKNOWN, CLEAN, HAS_BREAKPOINT };
+
+        BlockState block_state(uint16_t start);
+        void invalidate_blocks(unsigned int from, unsigned int to);
+        bool breakpoint_hit(uint16_t address) const;
+        bool evaluate(const BreakCondition &condition) const;
+        void describe_stop(StopReason reason, std::string &text) const;
+        void disassemble_mapped(uint16_t from, unsigned long count, std::string &text) const;
+
+        Chip8 &chip8;
+        std::bitset<MEMORY_SIZE> breakpoints;
+        std::map<uint16_t, BreakCondition> conditions;
+        std::bitset<MEMORY_SIZE> watched;
+        std::vector<std::pair<uint16_t, uint16_t>> watch_ranges;
+        CodeMap code_map{};
+        bool has_map{};
+
+        // Per block start: whether a breakpoint falls inside, and the block length
+        std::array<BlockState, MEMORY_SIZE> blocks{};
+        std::array<uint8_t, MEMORY_SIZE> block_lengths{};
+        unsigned int longest_block{};   // in instructions, bounds how far back a store reaches
+
+        bool watch_hit{};
+        uint16_t stopped_at{};
+        uint64_t executed{};
+};
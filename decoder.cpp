@@ -0,0 +1,24 @@
+#include "decoder.h"
+#include "isa.h"
+
+Instruction decode(uint16_t opcode)
+{
+        Instruction ins{};
+        ins.op = isa_decode(opcode);
+        ins.x = (opcode & 0x0f00u) >> 8u;
+        ins.y = (opcode & 0x00f0u) >> 4u;
+        ins.n = opcode & 0x000fu;
+        ins.kk = opcode & 0x00ffu;
+        ins.nnn = opcode & 0x0fffu;
+        return ins;
+}
+
+bool is_skip(Op op)
+{
+        return Isa::info(op).flags & ISA_SKIP;
+}
+
+bool ends_block(Op op)
+{
+        return Isa::info(op).flags & (ISA_SKIP | ISA_BRANCH);
+}
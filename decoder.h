@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+// Instruction kinds, named after the Chip8::op_* handler that executes them.
+// Isa::TABLE in isa.h describes each one and must stay in this order.
+enum class Op : uint8_t
+{
+        OP_NONE, // unassigned opcode, executes as a no-op
+        OP_00E0,
+        OP_00EE,
+        OP_0NNN,
+        OP_1NNN,
+        OP_2NNN,
+        OP_3XKK,
+        OP_4XKK,
+        OP_5XY0,
+        OP_6XKK,
+        OP_7XKK,
+        OP_8XY0,
+        OP_8XY1,
+        OP_8XY2,
+        OP_8XY3,
+        OP_8XY4,
+        OP_8XY5,
+        OP_8XY6,
+        OP_8XY7,
+        OP_8XYE,
+        OP_9XY0,
+        OP_ANNN,
+        OP_BNNN,
+        OP_CXKK,
+        OP_DXYN,
+        OP_EX9E,
+        OP_EXA1,
+        OP_FX07,
+        OP_FX0A,
+        OP_FX15,
+        OP_FX18,
+        OP_FX1E,
+        OP_FX29,
+        OP_FX33,
+        OP_FX55,
+        OP_FX65,
+};
+
+struct Instruction
+{
+        Op op;
+        uint8_t x;
+        uint8_t y;
+        uint8_t n;
+        uint8_t kk;
+        uint16_t nnn;
+};
+
+// Decodes one opcode exactly as Chip8::cycle executes it, see isa_decode
+Instruction decode(uint16_t opcode);
+
+// Instruction ends a basic block (jumps, calls, returns and skips)
+bool ends_block(Op op);
+
+// Instruction conditionally skips the next one
+bool is_skip(Op op);
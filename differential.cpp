@@ -0,0 +1,156 @@
+#include "differential.h"
+
+#include <cstdio>
+
+static const char *const FINDING_NAMES[FINDING_COUNT] = {"memory", "stack", "pc"};
+
+Differential::Differential(DifferentialOptions options) : options(options)
+{
+        chip8.instructions_per_frame = options.instructions_per_frame;
+}
+
+bool Differential::run(const uint8_t *data, size_t size)
+{
+        // Engines under test; each runs one frame the way its users drive it
+        struct Engine
+        {
+                const char *name;
+                void (*run_frame)(Chip8 &chip8);
+        };
+        static const Engine ENGINES[] = {
+#ifdef CHIP8_VIP_TIMING
+            // The VIP field budget has no counterpart in the reference, so step
+            // the same instruction count and tick once, as the reference does
+            {"interpreter",
+             [](Chip8 &chip8) {
+                     for (unsigned int i = 0; i < chip8.instructions_per_frame; ++i)
+                     {
+                             chip8.cycle();
+                     }
+                     chip8.tick_timers();
+                     chip8.age_keys();
+             }},
+#else
+            {"interpreter", [](Chip8 &chip8) { chip8.run_frame(); }},
+#endif
+        };
+
+        uint16_t keys = 0;
+        if (size >= FUZZ_HEADER_SIZE)
+        {
+                keys = data[0] | (data[1] << 8);
+                data += FUZZ_HEADER_SIZE;
+                size -= FUZZ_HEADER_SIZE;
+        }
+        else
+        {
+                size = 0;
+        }
+
+        ++totals.execs;
+        for (const Engine &engine : ENGINES)
+        {
+                chip8.reset();
+                chip8.load_rom(data, size);
+                chip8.seed(options.seed);
+                chip8.keypad = keys;
+                reference.reset(data, size, keys, options.seed);
+
+                for (unsigned int frame = 0; frame < options.frames; ++frame)
+                {
+                        engine.run_frame(chip8);
+                        reference.run_frame(options.instructions_per_frame);
+                        if (!compare(engine.name, frame))
+                        {
+                                return false;
+                        }
+                }
+                totals.frames += options.frames;
+        }
+
+        for (unsigned int kind = 0; kind < FINDING_COUNT; ++kind)
+        {
+                if (reference.findings[kind] != 0)
+                {
+                        ++totals.findings[kind];
+                        if (options.strict_bounds)
+                        {
+                                char text[128];
+                                std::snprintf(text, sizeof(text), "%s access out of bounds, first at pc 0x%03x",
+                                              FINDING_NAMES[kind], reference.first_finding_pc);
+                                failure_text = text;
+                                return false;
+                        }
+                }
+        }
+        return true;
+}
+
+// Names the first field that differs
+bool Differential::compare(const char *engine, unsigned int frame)
+{
+        char text[160];
+        auto differs = [&](const char *field, unsigned int at, unsigned int got, unsigned int expected) {
+                std::snprintf(text, sizeof(text), "%s diverged after frame %u: %s[%u] is 0x%x, reference 0x%x",
+                              engine, frame, field, at, got, expected);
+                failure_text = text;
+                return false;
+        };
+
+        if (chip8.pc != reference.pc)
+        {
+                return differs("pc", 0, chip8.pc, reference.pc);
+        }
+        if (chip8.index != reference.index)
+        {
+                return differs("index", 0, chip8.index, reference.index);
+        }
+        if (chip8.sp != reference.sp)
+        {
+                return differs("sp", 0, chip8.sp, reference.sp);
+        }
+        if (chip8.delay_timer != reference.delay_timer)
+        {
+                return differs("delay_timer", 0, chip8.delay_timer, reference.delay_timer);
+        }
+        if (chip8.sound_timer != reference.sound_timer)
+        {
+                return differs("sound_timer", 0, chip8.sound_timer, reference.sound_timer);
+        }
+        for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+        {
+                if (chip8.v_registers[i] != reference.v_registers[i])
+                {
+                        return differs("v", i, chip8.v_registers[i], reference.v_registers[i]);
+                }
+        }
+        for (unsigned int i = 0; i < STACK_LEVELS; ++i)
+        {
+                if (chip8.stack[i] != reference.stack[i])
+                {
+                        return differs("stack", i, chip8.stack[i], reference.stack[i]);
+                }
+        }
+        // Whole arrays first, they almost always match
+        if (chip8.memory != reference.memory)
+        {
+                for (unsigned int i = 0; i < MEMORY_SIZE; ++i)
+                {
+                        if (chip8.memory[i] != reference.memory[i])
+                        {
+                                return differs("memory", i, chip8.memory[i], reference.memory[i]);
+                        }
+                }
+        }
+        if (chip8.display != reference.display)
+        {
+                for (unsigned int i = 0; i < chip8.display.size(); ++i)
+                {
+                        if (chip8.display[i] != reference.display[i])
+                        {
+                                return differs("display", i, chip8.display[i], reference.display[i]);
+                        }
+                }
+        }
+        return true;
+}
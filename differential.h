@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chip8.h"
+#include "reference.h"
+#include <stdint.h>
+#include <array>
+#include <string>
+
+// A fuzz input is the keypad held for the whole run, little-endian, then the
+// ROM image loaded at START_ADDRESS
+const size_t FUZZ_HEADER_SIZE = 2;
+
+struct DifferentialOptions
+{
+        unsigned int frames{4};              // frames run and compared per input
+        unsigned int instructions_per_frame{10};
+        uint32_t seed{1};                    // Cxkk stream, the same for every input
+        bool strict_bounds{false};           // an out-of-bounds access fails the input
+};
+
+struct DifferentialStats
+{
+        uint64_t execs{};
+        uint64_t frames{};
+        std::array<uint64_t, FINDING_COUNT> findings{};    // inputs with each kind of access
+};
+
+// Runs inputs through ReferenceChip8 and every engine and compares full
+// machine state after each frame. Both machines are allocated once and
+// reset between inputs, so an input costs a few kilobytes of clearing
+// plus the instructions it runs.
+//
+// Out-of-bounds accesses are detected by the reference only; the engines
+// keep their wrapping fast path, and are checked to wrap the same way.
+class Differential
+{
+public:
+        explicit Differential(DifferentialOptions options);
+
+        // False if an engine diverged (or, with strict_bounds, the program
+        // went out of bounds); failure() then says where
+        bool run(const uint8_t *data, size_t size);
+
+        const std::string &failure() const { return failure_text; }
+        const DifferentialStats &stats() const { return totals; }
+
+private:
+        bool compare(const char *engine, unsigned int frame);
+
+        DifferentialOptions options;
+        Chip8 chip8;
+        ReferenceChip8 reference;
+        DifferentialStats totals;
+        std::string failure_text;
+};
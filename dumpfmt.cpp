@@ -0,0 +1,31 @@
+#include "state_dump.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " <Dump>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Could not read " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	std::string text;
+	bool valid = format_state_dump(data.data(), data.size(), text);
+	std::fwrite(text.data(), 1, text.size(), stdout);
+
+	if (!valid) {
+		std::cerr << argv[1] << ": malformed dump\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return 0;
+}
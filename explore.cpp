@@ -0,0 +1,84 @@
+#include "explorer.h"
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static void usage(char const *name)
+{
+	std::cerr << "Usage: " << name << " <ROM> [--frames K] [--depth D] [--states N] [--threads T]\n"
+	          << "       [--keys 0123...] [--no-idle] [--best <ScoreAddr>] [--warmup <Frames>]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2) {
+		usage(argv[0]);
+	}
+
+	ExploreOptions options;
+	options.threads = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int warmup = 0;
+
+	for (int i = 2; i < argc; ++i) {
+		std::string flag = argv[i];
+		if (flag == "--no-idle") {
+			options.idle_branch = false;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+		}
+		std::string value = argv[++i];
+		if (flag == "--frames") {
+			options.frames_per_step = std::stoul(value);
+		}
+		else if (flag == "--depth") {
+			options.max_depth = std::stoul(value);
+		}
+		else if (flag == "--states") {
+			options.max_states = std::stoul(value);
+		}
+		else if (flag == "--threads") {
+			options.threads = std::max(1ul, std::stoul(value));
+		}
+		else if (flag == "--keys") {
+			options.key_mask = 0;
+			for (char key : value) {
+				options.key_mask |= 1u << (std::stoul(std::string(1, key), nullptr, 16));
+			}
+		}
+		else if (flag == "--best") {
+			options.best_first = true;
+			options.score_address = std::stoul(value, nullptr, 0);
+		}
+		else if (flag == "--warmup") {
+			warmup = std::stoul(value);
+		}
+		else {
+			usage(argv[0]);
+		}
+	}
+
+	Chip8 root;
+	root.seed(1);
+	root.load_rom(argv[1]);
+	for (unsigned int frame = 0; frame < warmup; ++frame) {
+		root.run_frame();
+	}
+
+	Explorer explorer(options);
+	ExploreStats stats = explorer.run(root);
+
+	std::cout << "expanded:       " << stats.expanded << "\n";
+	std::cout << "generated:      " << stats.generated << "\n";
+	std::cout << "unique:         " << stats.generated - stats.duplicates << "\n";
+	std::cout << "duplicates:     " << stats.duplicates << " (" << 100.0 * stats.duplicate_ratio() << "%)\n";
+	std::cout << "max depth:      " << stats.max_depth_reached << "\n";
+	if (stats.table_full) {
+		std::cout << "stopped early:  state table full\n";
+	}
+	std::cout << "seconds:        " << stats.seconds << "\n";
+	std::cout << "states/second:  " << stats.states_per_second() << "\n";
+	return 0;
+}
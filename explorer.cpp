@@ -0,0 +1,224 @@
+#include "explorer.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const uint64_t EMPTY_SLOT = 0;
+
+StateSet::StateSet(size_t min_capacity)
+{
+        size_t capacity = 1024;
+        while (capacity < min_capacity)
+        {
+                capacity <<= 1;
+        }
+        slots = std::make_unique<std::atomic<uint64_t>[]>(capacity);
+        for (size_t i = 0; i < capacity; ++i)
+        {
+                slots[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+        }
+        mask = capacity - 1;
+        this->capacity = capacity;
+}
+
+StateSet::Insert StateSet::insert(uint64_t hash)
+{
+        // 0 marks an empty slot
+        if (hash == EMPTY_SLOT)
+        {
+                hash = 1;
+        }
+
+        for (size_t probe = 0, slot = hash & mask; probe <= mask; ++probe, slot = (slot + 1) & mask)
+        {
+                uint64_t current = slots[slot].load(std::memory_order_acquire);
+                if (current == hash)
+                {
+                        return DUPLICATE;
+                }
+                if (current == EMPTY_SLOT)
+                {
+                        // Keep one slot free so probes for new hashes always end
+                        if (count.fetch_add(1, std::memory_order_relaxed) + 1 >= capacity)
+                        {
+                                count.fetch_sub(1, std::memory_order_relaxed);
+                                return FULL;
+                        }
+                        if (slots[slot].compare_exchange_strong(current, hash, std::memory_order_acq_rel))
+                        {
+                                return INSERTED;
+                        }
+                        count.fetch_sub(1, std::memory_order_relaxed);
+                        if (current == hash)
+                        {
+                                return DUPLICATE;
+                        }
+                }
+        }
+        return FULL;
+}
+
+struct Explorer::Node
+{
+        std::unique_ptr<Chip8> state;
+        unsigned int depth;
+        uint8_t score;
+        uint64_t sequence;
+};
+
+Explorer::Explorer(ExploreOptions options)
+    : options(options)
+{
+}
+
+// state_hash leaves out the RNG, so states that only differ in what Cxkk
+// returns next would merge. The default engine is an LCG, whose next output
+// determines its state, so fold that in.
+uint64_t Explorer::state_key(Chip8 &state)
+{
+        std::default_random_engine next = state.rand_gen;
+        return state.state_hash() ^ (uint64_t(next()) * 0x9e3779b97f4a7c15ull);
+}
+
+void Explorer::expand(const Node &node, std::vector<Node> &children, StateSet &seen, ExploreStats &stats) const
+{
+        for (unsigned int key = 0; key <= KEY_COUNT; ++key)
+        {
+                // key == KEY_COUNT is the branch with no key held
+                bool branch = (key == KEY_COUNT) ? options.idle_branch : (options.key_mask >> key) & 1u;
+                if (!branch)
+                {
+                        continue;
+                }
+
+                auto child = std::make_unique<Chip8>(*node.state);
+                child->keypad = (key < KEY_COUNT) ? 1u << key : 0;
+                for (unsigned int frame = 0; frame < options.frames_per_step; ++frame)
+                {
+                        child->run_frame();
+                }
+                child->keypad = 0;
+
+                StateSet::Insert inserted = seen.insert(state_key(*child));
+                if (inserted == StateSet::FULL)
+                {
+                        stats.table_full = true;
+                        return;
+                }
+                ++stats.generated;
+                if (inserted == StateSet::DUPLICATE)
+                {
+                        ++stats.duplicates;
+                        continue;
+                }
+
+                unsigned int depth = node.depth + 1;
+                stats.max_depth_reached = std::max(stats.max_depth_reached, depth);
+                if (depth < options.max_depth)
+                {
+                        uint8_t score = child->memory[options.score_address & (MEMORY_SIZE - 1)];
+                        children.push_back(Node{std::move(child), depth, score, 0});
+                }
+        }
+}
+
+ExploreStats Explorer::run(const Chip8 &root)
+{
+        auto start = std::chrono::steady_clock::now();
+        unsigned int branches = std::popcount(options.key_mask) + (options.idle_branch ? 1 : 0);
+        StateSet seen(2 * (options.max_states + 1) * branches);
+
+        // Frontier ordered by depth (breadth-first) or by score (best-first)
+        bool best_first = options.best_first;
+        auto later = [best_first](const Node &a, const Node &b) {
+                if (best_first && a.score != b.score)
+                {
+                        return a.score < b.score;
+                }
+                if (a.depth != b.depth)
+                {
+                        return a.depth > b.depth;
+                }
+                return a.sequence > b.sequence;
+        };
+
+        std::vector<Node> frontier;
+        uint64_t sequence = 0;
+        {
+                auto state = std::make_unique<Chip8>(root);
+                seen.insert(state_key(*state));
+                frontier.push_back(Node{std::move(state), 0, 0, sequence++});
+        }
+
+        std::mutex lock;
+        std::condition_variable changed;
+        unsigned int active = 0;
+        uint64_t expanded = 0;
+        ExploreStats total{};
+        bool full = false;
+
+        auto worker = [&]() {
+                ExploreStats stats{};
+                std::vector<Node> children;
+
+                std::unique_lock<std::mutex> guard(lock);
+                while (true)
+                {
+                        changed.wait(guard, [&]() {
+                                return !frontier.empty() || active == 0 || expanded >= options.max_states || full;
+                        });
+                        if (frontier.empty() || expanded >= options.max_states || full)
+                        {
+                                break;
+                        }
+
+                        std::pop_heap(frontier.begin(), frontier.end(), later);
+                        Node node = std::move(frontier.back());
+                        frontier.pop_back();
+                        ++active;
+                        ++expanded;
+                        guard.unlock();
+
+                        expand(node, children, seen, stats);
+                        ++stats.expanded;
+
+                        guard.lock();
+                        full = full || stats.table_full;
+                        for (Node &child : children)
+                        {
+                                child.sequence = sequence++;
+                                frontier.push_back(std::move(child));
+                                std::push_heap(frontier.begin(), frontier.end(), later);
+                        }
+                        children.clear();
+                        --active;
+                        changed.notify_all();
+                }
+
+                total.expanded += stats.expanded;
+                total.generated += stats.generated;
+                total.duplicates += stats.duplicates;
+                total.max_depth_reached = std::max(total.max_depth_reached, stats.max_depth_reached);
+                total.table_full = total.table_full || stats.table_full;
+                changed.notify_all();
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned int i = 1; i < options.threads; ++i)
+        {
+                pool.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread : pool)
+        {
+                thread.join();
+        }
+
+        total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return total;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+// Fixed-capacity set of 64-bit hashes, safe for concurrent inserts.
+// Open addressing with linear probing; a slot is claimed with one CAS.
+class StateSet
+{
+public:
+        enum Insert { INSERTED, DUPLICATE, FULL };
+
+        explicit StateSet(size_t min_capacity);
+
+        // FULL only if hash is new and there is no room left for it
+        Insert insert(uint64_t hash);
+        size_t size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        size_t mask;
+        size_t capacity;
+        std::atomic<size_t> count{0};
+};
+
+struct ExploreOptions
+{
+        unsigned int frames_per_step{10};    // K: frames each input is held for
+        uint16_t key_mask{0xffffu};          // keys to branch over
+        bool idle_branch{true};              // also branch with no key held
+        unsigned int max_depth{8};
+        size_t max_states{20000};            // stop after expanding this many
+        unsigned int threads{1};
+        bool best_first{false};              // otherwise breadth-first
+        uint16_t score_address{0};           // best-first expands the highest memory[score_address]
+};
+
+struct ExploreStats
+{
+        uint64_t expanded{};
+        uint64_t generated{};
+        uint64_t duplicates{};
+        unsigned int max_depth_reached{};
+        bool table_full{};                   // stopped early, the StateSet ran out of room
+        double seconds{};
+
+        double states_per_second() const { return seconds > 0 ? generated / seconds : 0; }
+        double duplicate_ratio() const { return generated ? double(duplicates) / generated : 0; }
+};
+
+// Searches the state space reachable from a starting machine state by
+// holding each keypad input for K frames, pruning states whose
+// Chip8::state_hash and RNG state were already seen.
+class Explorer
+{
+public:
+        explicit Explorer(ExploreOptions options);
+
+        ExploreStats run(const Chip8 &root);
+
+private:
+        struct Node;
+        static uint64_t state_key(Chip8 &state);
+        void expand(const Node &node, std::vector<Node> &children, StateSet &seen, ExploreStats &stats) const;
+
+        ExploreOptions options;
+};
@@ -0,0 +1,139 @@
+#include "scheduler.h"
+#include "metrics.h"
+#include "shm_export.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+
+// Whole decimal numbers only, so a mistyped flag is not read as a count
+static bool parse_count(char const* text, unsigned long long &value)
+{
+	char* end = nullptr;
+	value = std::strtoull(text, &end, 10);
+	return end != text && *end == '\0' && text[0] != '-';
+}
+
+int main(int argc, char ** argv)
+{
+	auto usage = [&]() {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Instances> <Frames> [Workers] [--paced] [--heap] [--export <ShmName>] [--metrics <Prefix>]\n";
+		std::exit(EXIT_FAILURE);
+	};
+	if (argc < 4 || argc > 11) {
+		usage();
+	}
+
+	unsigned long long instance_count = 0;
+	unsigned long long frames = 0;
+	if (!parse_count(argv[2], instance_count) || !parse_count(argv[3], frames)) {
+		usage();
+	}
+	if (instance_count == 0) {
+		std::cerr << "Instances must be at least 1\n";
+		std::exit(EXIT_FAILURE);
+	}
+	unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+	bool paced = false;
+	bool pooled = true;
+	char const* export_name = nullptr;
+	char const* metrics_prefix = nullptr;
+	for (int i = 4; i < argc; ++i) {
+		unsigned long long count = 0;
+		if (std::strcmp(argv[i], "--paced") == 0) {
+			paced = true;
+		}
+		else if (std::strcmp(argv[i], "--heap") == 0) {
+			pooled = false;
+		}
+		else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+			export_name = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+			metrics_prefix = argv[++i];
+		}
+		else if (parse_count(argv[i], count) && count > 0) {
+			workers = count;
+		}
+		else {
+			usage();
+		}
+	}
+
+	Chip8 initial;
+	initial.load_rom(argv[1]);
+
+	Scheduler scheduler(workers, std::chrono::microseconds(paced ? 16667 : 0), pooled);
+	for (unsigned int i = 0; i < instance_count; ++i) {
+		initial.seed(i);
+		scheduler.spawn(initial, frames);
+	}
+
+	ShmExporter exporter;
+	if (export_name) {
+		if (!exporter.create(export_name, instance_count)) {
+			std::cerr << "Could not create shared memory " << export_name << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		scheduler.on_frame = [&exporter](Instance &instance) {
+			exporter.publish(instance.id, instance.chip8, instance.frames - 1);
+		};
+	}
+
+	// Taps a random key on a random instance now and then, waking any parked on Fx0A
+	std::atomic<bool> done{false};
+	std::thread input([&]() {
+		std::mt19937 rng(1);
+		auto &instances = scheduler.instances();
+		while (!done.load()) {
+			Instance &instance = *instances[rng() % instances.size()];
+			scheduler.set_keys(instance, 1u << (rng() % KEY_COUNT));
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			scheduler.set_keys(instance, 0);
+		}
+	});
+
+	// Writes <Prefix>.prom and appends to <Prefix>.json every second
+	std::unique_ptr<MetricsExporter> metrics;
+	if (metrics_prefix) {
+		metrics = std::make_unique<MetricsExporter>(metrics_prefix, std::chrono::seconds(1));
+		for (auto &instance : scheduler.instances()) {
+			metrics->watch(instance->id, instance->chip8);
+		}
+		metrics->start();
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	scheduler.run();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	done.store(true);
+	input.join();
+	if (metrics) {
+		metrics->stop();
+	}
+
+	uint64_t total = 0;
+	for (auto &instance : scheduler.instances()) {
+		total += instance->frames;
+	}
+	std::cout << instance_count << " instances, " << workers << " workers\n";
+	if (pooled) {
+		PoolStats pools{};
+		std::set<int> nodes;
+		for (const PoolStats &stats : scheduler.pool_stats()) {
+			pools.slabs += stats.slabs;
+			pools.huge_slabs += stats.huge_slabs;
+			if (stats.slabs > 0) {
+				nodes.insert(stats.node);
+			}
+		}
+		std::cout << "Pooled: " << pools.slabs << " slabs, " << pools.huge_slabs << " on huge pages, "
+		          << nodes.size() << " nodes\n";
+	}
+	else {
+		std::cout << "Heap allocated\n";
+	}
+	std::cout << total << " frames in " << seconds << " s (" << total / seconds << " frames/s)\n";
+	return 0;
+}
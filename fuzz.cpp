@@ -0,0 +1,112 @@
+#include "differential.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// libFuzzer and AFL++ (built with -fsanitize=fuzzer) call this per input.
+// CHIP8_FUZZ_STRICT=1 also treats out-of-bounds accesses as crashes.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static Differential differential([]() {
+		DifferentialOptions options;
+		char const* strict = std::getenv("CHIP8_FUZZ_STRICT");
+		options.strict_bounds = strict && std::strcmp(strict, "0") != 0;
+		return options;
+	}());
+
+	if (!differential.run(data, size)) {
+		std::cerr << differential.failure() << "\n";
+		std::abort();
+	}
+	return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+static void usage(char const *name)
+{
+	std::cerr << "Usage: " << name << " [--runs N] [--frames F] [--seed S] [--strict] [Input...]\n";
+	std::exit(EXIT_FAILURE);
+}
+
+// Without libFuzzer: replays the given inputs (AFL's @@), or runs random ones
+int main(int argc, char ** argv)
+{
+	DifferentialOptions options;
+	uint64_t runs = 1000000;
+	uint32_t input_seed = 1;
+	std::vector<char const*> inputs;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string flag = argv[i];
+		if (flag == "--strict") {
+			options.strict_bounds = true;
+		}
+		else if (flag.rfind("--", 0) == 0) {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+			}
+			unsigned long value = std::stoul(argv[++i]);
+			if (flag == "--runs") {
+				runs = value;
+			}
+			else if (flag == "--frames") {
+				options.frames = value;
+			}
+			else if (flag == "--seed") {
+				input_seed = value;
+			}
+			else {
+				usage(argv[0]);
+			}
+		}
+		else {
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	Differential differential(options);
+
+	if (!inputs.empty()) {
+		for (char const* path : inputs) {
+			std::ifstream file(path, std::ios::binary);
+			std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (!differential.run(data.data(), data.size())) {
+				std::cerr << path << ": " << differential.failure() << "\n";
+				std::abort();
+			}
+		}
+		std::cout << inputs.size() << " inputs match\n";
+		return 0;
+	}
+
+	// Short random programs, so most of each run is spent executing rather than clearing
+	std::mt19937 rng(input_seed);
+	std::vector<uint8_t> data(FUZZ_HEADER_SIZE + 256);
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t run = 0; run < runs; ++run) {
+		size_t size = FUZZ_HEADER_SIZE + 2 * (rng() % 128);
+		for (size_t i = 0; i < size; i += 4) {
+			uint32_t word = rng();
+			std::memcpy(&data[i], &word, std::min<size_t>(4, size - i));
+		}
+		if (!differential.run(data.data(), size)) {
+			char const* path = "chip8-fuzz-failure.bin";
+			std::ofstream(path, std::ios::binary).write(reinterpret_cast<char const*>(data.data()), size);
+			std::cerr << differential.failure() << "\nInput written to " << path << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const DifferentialStats &stats = differential.stats();
+	std::cout << stats.execs << " execs in " << seconds << " s (" << stats.execs / seconds << " execs/s)\n";
+	std::cout << "out of bounds: memory " << stats.findings[FINDING_MEMORY] << ", stack "
+	          << stats.findings[FINDING_STACK] << ", pc " << stats.findings[FINDING_PC] << " inputs\n";
+	return 0;
+}
+#endif
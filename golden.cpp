@@ -0,0 +1,136 @@
+#include "chip8.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+const uint32_t GOLDEN_SEED = 1;
+const unsigned int DEFAULT_FRAMES = 600;
+
+#ifdef CHIP8_GOLDEN_AOT
+#include "aot.h"
+
+// Defined by the ROM's code from chip8-recompile, linked into this build
+unsigned int CHIP8_GOLDEN_AOT(Chip8 &c, unsigned int budget);
+#endif
+
+#ifdef CHIP8_GOLDEN_AOT
+const char *const ENGINE = " (recompiled)";
+#else
+const char *const ENGINE = "";
+#endif
+
+#ifdef CHIP8_VIP_TIMING
+const char *const MODE = "vip";
+#else
+const char *const MODE = "ipf10";
+#endif
+
+static std::vector<uint64_t> run(char const *rom_file_name, unsigned int frames)
+{
+	Chip8 chip8;
+	chip8.seed(GOLDEN_SEED);
+	chip8.load_rom(rom_file_name);
+
+	std::vector<uint64_t> hashes;
+	hashes.reserve(frames);
+	for (unsigned int i = 0; i < frames; ++i) {
+#ifdef CHIP8_GOLDEN_AOT
+		// The same frame as run_frame, through the recompiled blocks
+		aot_run(chip8, CHIP8_GOLDEN_AOT, chip8.instructions_per_frame);
+		chip8.age_keys();
+#else
+		chip8.run_frame();
+#endif
+		hashes.push_back(chip8.hash_frame());
+	}
+	return hashes;
+}
+
+static int record(char const *rom_file_name, char const *golden_file_name, unsigned int frames)
+{
+	std::vector<uint64_t> hashes = run(rom_file_name, frames);
+
+	FILE *file = std::fopen(golden_file_name, "w");
+	if (!file) {
+		std::cerr << "Could not write " << golden_file_name << "\n";
+		return EXIT_FAILURE;
+	}
+
+	std::fprintf(file, "chip8-golden 1 %s %u\n", MODE, frames);
+	for (uint64_t hash : hashes) {
+		std::fprintf(file, "%016" PRIx64 "\n", hash);
+	}
+	std::fclose(file);
+	return EXIT_SUCCESS;
+}
+
+static int check(char const *rom_file_name, char const *golden_file_name)
+{
+	FILE *file = std::fopen(golden_file_name, "r");
+	if (!file) {
+		std::cerr << "Could not read " << golden_file_name << "\n";
+		return EXIT_FAILURE;
+	}
+
+	char mode[16] = {};
+	unsigned int frames = 0;
+	if (std::fscanf(file, "chip8-golden 1 %15s %u", mode, &frames) != 2) {
+		std::cerr << golden_file_name << ": bad header\n";
+		std::fclose(file);
+		return EXIT_FAILURE;
+	}
+	if (std::strcmp(mode, MODE) != 0) {
+		std::cerr << golden_file_name << ": recorded in " << mode << " mode, this build runs " << MODE << "\n";
+		std::fclose(file);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint64_t> expected(frames);
+	for (uint64_t &hash : expected) {
+		if (std::fscanf(file, "%" SCNx64, &hash) != 1) {
+			std::cerr << golden_file_name << ": truncated\n";
+			std::fclose(file);
+			return EXIT_FAILURE;
+		}
+	}
+	std::fclose(file);
+
+	std::vector<uint64_t> actual = run(rom_file_name, frames);
+	for (unsigned int i = 0; i < frames; ++i) {
+		if (actual[i] != expected[i]) {
+			std::cerr << rom_file_name << ": frame " << i << " differs from " << golden_file_name << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+#ifdef CHIP8_GOLDEN_AOT
+	// Would pass trivially if everything fell back to Chip8::cycle
+	if (metrics_snapshot().values[METRIC_AOT_COMPILED] == 0) {
+		std::cerr << rom_file_name << ": no instructions ran in recompiled code\n";
+		return EXIT_FAILURE;
+	}
+#endif
+
+	std::cout << rom_file_name << ": " << frames << " frames match" << ENGINE << "\n";
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char ** argv)
+{
+	bool recording = argc >= 2 && std::strcmp(argv[1], "record") == 0;
+	bool checking = argc >= 2 && std::strcmp(argv[1], "check") == 0;
+
+	if (!(recording && (argc == 4 || argc == 5)) && !(checking && argc == 4)) {
+		std::cerr << "Usage: " << argv[0] << " record <ROM> <Golden> [Frames]\n";
+		std::cerr << "       " << argv[0] << " check <ROM> <Golden>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	if (recording) {
+		unsigned int frames = argc == 5 ? std::stoi(argv[4]) : DEFAULT_FRAMES;
+		return record(argv[2], argv[3], frames);
+	}
+	return check(argv[2], argv[3]);
+}
@@ -0,0 +1,48 @@
+#include "input_script.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+bool InputScript::load(std::string filename)
+{
+        std::ifstream file(filename);
+
+        if (!file.is_open())
+        {
+                return false;
+        }
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+                std::istringstream words(line);
+                uint32_t frame;
+                unsigned int key;
+                std::string state;
+                if (line.empty() || line[0] == '#')
+                {
+                        continue;
+                }
+                if (!(words >> frame >> std::hex >> key >> state) || key >= KEY_COUNT || (state != "down" && state != "up"))
+                {
+                        return false;
+                }
+                events.push_back({frame, static_cast<uint8_t>(key), state == "down"});
+        }
+
+        std::stable_sort(events.begin(), events.end(),
+                         [](const InputEvent &a, const InputEvent &b) { return a.frame < b.frame; });
+        next = 0;
+        return true;
+}
+
+void InputScript::apply(uint32_t frame, Chip8 &chip8)
+{
+        while (next < events.size() && events[next].frame <= frame)
+        {
+                uint16_t bit = 1u << events[next].key;
+                chip8.keypad = events[next].down ? (chip8.keypad | bit) : (chip8.keypad & ~bit);
+                ++next;
+        }
+}
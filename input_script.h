@@ -0,0 +1,32 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Scripted keypad input for headless runs, one event per line:
+//
+//   <frame> <key 0-f> <down|up>
+//
+// Blank lines and lines starting with '#' are ignored.
+struct InputEvent
+{
+        uint32_t frame;
+        uint8_t key;
+        bool down;
+};
+
+class InputScript
+{
+public:
+        bool load(std::string filename);
+
+        // Applies every event scheduled for frame, call before running it
+        void apply(uint32_t frame, Chip8 &chip8);
+
+        std::vector<InputEvent> events;
+
+private:
+        size_t next{};
+};
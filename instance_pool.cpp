@@ -0,0 +1,199 @@
+#include "instance_pool.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <new>
+
+// Slots start on cache line boundaries so neighbours never share a line
+const size_t SLOT_SIZE = (sizeof(Chip8) + 63) & ~size_t(63);
+const size_t SLOTS_PER_SLAB = HUGE_PAGE_SIZE / SLOT_SIZE;
+
+// From <numaif.h>, called through syscall() to avoid a libnuma dependency
+const int MPOL_PREFERRED_NODE = 1;
+
+static int current_node()
+{
+        unsigned int cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        {
+                return -1;
+        }
+        return node;
+}
+
+struct HugeMapping
+{
+        uintptr_t start;
+        uintptr_t end;
+        size_t pages;              // transparent huge pages backing it
+};
+
+// Mappings holding any of bases, with AnonHugePages from /proc/self/smaps
+static std::vector<HugeMapping> huge_pages_in(const std::vector<uintptr_t> &bases)
+{
+        std::vector<HugeMapping> found;
+        FILE *smaps = std::fopen("/proc/self/smaps", "r");
+        if (!smaps)
+        {
+                return found;
+        }
+
+        char line[256];
+        bool inside = false;
+        unsigned long start = 0, end = 0, kilobytes = 0;
+        while (std::fgets(line, sizeof(line), smaps))
+        {
+                if (std::sscanf(line, "%lx-%lx ", &start, &end) == 2)
+                {
+                        inside = std::any_of(bases.begin(), bases.end(),
+                                             [&](uintptr_t base) { return base >= start && base < end; });
+                }
+                else if (inside && std::sscanf(line, "AnonHugePages: %lu kB", &kilobytes) == 1)
+                {
+                        found.push_back({start, end, kilobytes * 1024 / HUGE_PAGE_SIZE});
+                }
+        }
+        std::fclose(smaps);
+        return found;
+}
+
+InstancePool::~InstancePool()
+{
+        for (Slab &slab : slabs)
+        {
+                for (size_t i = 0; i < slab.used; ++i)
+                {
+                        reinterpret_cast<Chip8 *>(static_cast<char *>(slab.base) + i * SLOT_SIZE)->~Chip8();
+                }
+                munmap(slab.base, slab.length);
+        }
+}
+
+void InstancePool::add_slab()
+{
+        static_assert(SLOTS_PER_SLAB > 0, "Chip8 no longer fits a huge page");
+
+        // Reserved hugetlbfs pages first, then a 2 MB aligned mapping that
+        // transparent huge pages can back
+        bool hugetlb = true;
+        void *base = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED)
+        {
+                size_t padded = 2 * HUGE_PAGE_SIZE;
+                char *raw = static_cast<char *>(mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                if (raw == MAP_FAILED)
+                {
+                        throw std::bad_alloc();
+                }
+
+                uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+                char *start = reinterpret_cast<char *>(aligned);
+                if (start > raw)
+                {
+                        munmap(raw, start - raw);
+                }
+                munmap(start + HUGE_PAGE_SIZE, raw + padded - (start + HUGE_PAGE_SIZE));
+
+                base = start;
+                hugetlb = false;
+                madvise(base, HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+        }
+
+        // Prefer the pool's node, else the one this thread runs on, where
+        // construction below touches it first
+        node = (home_node >= 0) ? home_node : current_node();
+        if (node >= 0 && node < 64)
+        {
+                unsigned long mask = 1ul << node;
+                syscall(SYS_mbind, base, HUGE_PAGE_SIZE, MPOL_PREFERRED_NODE, &mask, sizeof(mask) * 8 + 1, 0);
+        }
+
+        slabs.push_back(Slab{base, HUGE_PAGE_SIZE, 0, hugetlb});
+}
+
+// A constructed instance from the free list, or a fresh one from the last slab
+Chip8 *InstancePool::take(void *&slot)
+{
+        ++in_use;
+        if (!free_list.empty())
+        {
+                Chip8 *instance = free_list.back();
+                free_list.pop_back();
+                return instance;
+        }
+
+        if (slabs.empty() || slabs.back().used == SLOTS_PER_SLAB)
+        {
+                add_slab();
+        }
+        Slab &slab = slabs.back();
+        slot = static_cast<char *>(slab.base) + slab.used * SLOT_SIZE;
+        ++slab.used;
+        return nullptr;
+}
+
+Chip8 *InstancePool::acquire(const MemoryImage &image)
+{
+        void *slot = nullptr;
+        if (Chip8 *instance = take(slot))
+        {
+                instance->reset(image);
+                return instance;
+        }
+        return new (slot) Chip8(image);
+}
+
+Chip8 *InstancePool::acquire(const Chip8 &prototype)
+{
+        void *slot = nullptr;
+        if (Chip8 *instance = take(slot))
+        {
+                *instance = prototype;
+                return instance;
+        }
+        return new (slot) Chip8(prototype);
+}
+
+void InstancePool::release(Chip8 *instance)
+{
+        --in_use;
+        free_list.push_back(instance);
+}
+
+PoolStats InstancePool::stats() const
+{
+        PoolStats stats{};
+        stats.slabs = slabs.size();
+
+        // The advice can be ignored, so ask the kernel what backs the rest.
+        // Slabs are whole aligned huge pages, so each one counted in a
+        // mapping is one slab.
+        std::vector<uintptr_t> advised;
+        for (const Slab &slab : slabs)
+        {
+                if (slab.hugetlb)
+                {
+                        ++stats.huge_slabs;
+                }
+                else
+                {
+                        advised.push_back(reinterpret_cast<uintptr_t>(slab.base));
+                }
+        }
+        for (const HugeMapping &mapping : huge_pages_in(advised))
+        {
+                size_t slabs_in_mapping = std::count_if(advised.begin(), advised.end(), [&](uintptr_t base) {
+                        return base >= mapping.start && base < mapping.end;
+                });
+                stats.huge_slabs += std::min(mapping.pages, slabs_in_mapping);
+        }
+        stats.capacity = slabs.size() * SLOTS_PER_SLAB;
+        stats.in_use = in_use;
+        stats.node = node;
+        return stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chip8.h"
+#include <stddef.h>
+#include <vector>
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+struct PoolStats
+{
+        size_t slabs{};
+        size_t huge_slabs{};       // slabs the kernel backs with hugetlbfs or transparent huge pages
+        size_t capacity{};         // instances the slabs hold
+        size_t in_use{};
+        int node{-1};              // NUMA node of the last slab, -1 if unknown
+};
+
+// Carves Chip8 instances out of 2 MB slabs so thousands of them sit in a
+// few huge pages instead of being scattered across the heap.
+//
+// Not thread-safe: give each worker thread its own pool. Slabs are placed on
+// the pool's NUMA node, or on the node of the thread that maps them, so
+// instances stay local to the worker that runs them.
+// Released instances stay constructed and go back on a free list; acquiring
+// one resets it in place rather than building a new Chip8.
+class InstancePool
+{
+public:
+        InstancePool() = default;
+        // Places slabs on node whichever thread maps them; -1 for the mapping thread's
+        explicit InstancePool(int node) : home_node(node) {}
+        ~InstancePool();
+
+        InstancePool(const InstancePool &) = delete;
+        InstancePool &operator=(const InstancePool &) = delete;
+
+        // A power-on instance with no ROM loaded
+        Chip8 *acquire() { return acquire(POWER_ON_IMAGE); }
+        // A power-on instance with image as memory, e.g. one with a ROM loaded
+        Chip8 *acquire(const MemoryImage &image);
+        // A copy of prototype, e.g. one with the ROM already loaded
+        Chip8 *acquire(const Chip8 &prototype);
+        void release(Chip8 *instance);
+
+        PoolStats stats() const;
+
+private:
+        struct Slab
+        {
+                void *base;
+                size_t length;
+                size_t used;       // slots constructed so far
+                bool hugetlb;      // from reserved hugetlbfs pages, otherwise advised for THP
+        };
+
+        // A released instance, or nullptr and a fresh slot to construct in
+        Chip8 *take(void *&slot);
+        void add_slab();
+
+        std::vector<Slab> slabs;
+        std::vector<Chip8 *> free_list;
+        size_t in_use{};
+        int home_node{-1};
+        int node{-1};
+};
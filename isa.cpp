@@ -0,0 +1,77 @@
+#include "isa.h"
+
+#include <cstdio>
+
+std::string disassemble(uint16_t opcode)
+{
+        const OpInfo &info = Isa::info(isa_decode(opcode));
+        std::string text = info.mnemonic;
+        if (*info.operands)
+        {
+                text += ' ';
+        }
+
+        char field[8];
+        for (const char *p = info.operands; *p; ++p)
+        {
+                if (*p != '{')
+                {
+                        text += *p;
+                        continue;
+                }
+                std::string name;
+                for (++p; *p && *p != '}'; ++p)
+                {
+                        name += *p;
+                }
+                if (name == "x")
+                {
+                        std::snprintf(field, sizeof(field), "%X", (opcode >> 8) & 0xfu);
+                }
+                else if (name == "y")
+                {
+                        std::snprintf(field, sizeof(field), "%X", (opcode >> 4) & 0xfu);
+                }
+                else if (name == "n")
+                {
+                        std::snprintf(field, sizeof(field), "%u", opcode & 0xfu);
+                }
+                else if (name == "kk")
+                {
+                        std::snprintf(field, sizeof(field), "0x%02x", opcode & 0xffu);
+                }
+                else if (name == "nnn")
+                {
+                        std::snprintf(field, sizeof(field), "0x%03x", opcode & 0xfffu);
+                }
+                else
+                {
+                        std::snprintf(field, sizeof(field), "0x%04x", opcode);
+                }
+                text += field;
+                if (!*p)
+                {
+                        break;
+                }
+        }
+        return text;
+}
+
+void disassemble(const uint8_t *code, size_t size, uint16_t address, std::string &text)
+{
+        char line[64];
+        size_t i = 0;
+        for (; i + 1 < size; i += 2, address += 2)
+        {
+                uint16_t opcode = (code[i] << 8u) | code[i + 1];
+                std::snprintf(line, sizeof(line), "%03x  %04x  ", address, opcode);
+                text += line;
+                text += disassemble(opcode);
+                text += '\n';
+        }
+        if (i < size)
+        {
+                std::snprintf(line, sizeof(line), "%03x  %02x    .byte 0x%02x\n", address, code[i], code[i]);
+                text += line;
+        }
+}
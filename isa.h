@@ -0,0 +1,196 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <string>
+
+using Handler = void (Chip8::*)(uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn);
+
+const uint8_t ISA_SKIP = 0x1;      // conditionally skips the next instruction
+const uint8_t ISA_BRANCH = 0x2;    // always leaves the straight-line path
+
+struct OpInfo
+{
+        Op op;
+        uint16_t mask;             // opcode bits that identify the instruction
+        uint16_t match;
+        const char *handler_name;  // as chip8-recompile emits calls to it
+        const char *mnemonic;
+        const char *operands;      // {x} {y} {n} {kk} {nnn} {opcode} stand for the fields
+        Handler handler;
+        uint8_t flags;
+};
+
+// The instruction set, in Op order. Decoding, dispatch in Chip8::cycle,
+// recompiled code, block analysis and disassembly are all generated from
+// this table; add an instruction here and nowhere else.
+struct Isa
+{
+        static constexpr OpInfo TABLE[] = {
+            {Op::OP_NONE, 0x0000, 0x0000, "op_null", ".word", "{opcode}", &Chip8::op_null, 0},
+            {Op::OP_00E0, 0xffff, 0x00e0, "op_00e0", "CLS", "", &Chip8::op_00e0, 0},
+            {Op::OP_00EE, 0xffff, 0x00ee, "op_00ee", "RET", "", &Chip8::op_00ee, ISA_BRANCH},
+            {Op::OP_0NNN, 0xf000, 0x0000, "op_0nnn", "SYS", "{nnn}", &Chip8::op_0nnn, 0},
+            {Op::OP_1NNN, 0xf000, 0x1000, "op_1nnn", "JP", "{nnn}", &Chip8::op_1nnn, ISA_BRANCH},
+            {Op::OP_2NNN, 0xf000, 0x2000, "op_2nnn", "CALL", "{nnn}", &Chip8::op_2nnn, ISA_BRANCH},
+            {Op::OP_3XKK, 0xf000, 0x3000, "op_3xkk", "SE", "V{x}, {kk}", &Chip8::op_3xkk, ISA_SKIP},
+            {Op::OP_4XKK, 0xf000, 0x4000, "op_4xkk", "SNE", "V{x}, {kk}", &Chip8::op_4xkk, ISA_SKIP},
+            {Op::OP_5XY0, 0xf00f, 0x5000, "op_5xy0", "SE", "V{x}, V{y}", &Chip8::op_5xy0, ISA_SKIP},
+            {Op::OP_6XKK, 0xf000, 0x6000, "op_6xkk", "LD", "V{x}, {kk}", &Chip8::op_6xkk, 0},
+            {Op::OP_7XKK, 0xf000, 0x7000, "op_7xkk", "ADD", "V{x}, {kk}", &Chip8::op_7xkk, 0},
+            {Op::OP_8XY0, 0xf00f, 0x8000, "op_8xy0", "LD", "V{x}, V{y}", &Chip8::op_8xy0, 0},
+            {Op::OP_8XY1, 0xf00f, 0x8001, "op_8xy1", "OR", "V{x}, V{y}", &Chip8::op_8xy1, 0},
+            {Op::OP_8XY2, 0xf00f, 0x8002, "op_8xy2", "AND", "V{x}, V{y}", &Chip8::op_8xy2, 0},
+            {Op::OP_8XY3, 0xf00f, 0x8003, "op_8xy3", "XOR", "V{x}, V{y}", &Chip8::op_8xy3, 0},
+            {Op::OP_8XY4, 0xf00f, 0x8004, "op_8xy4", "ADD", "V{x}, V{y}", &Chip8::op_8xy4, 0},
+            {Op::OP_8XY5, 0xf00f, 0x8005, "op_8xy5", "SUB", "V{x}, V{y}", &Chip8::op_8xy5, 0},
+            {Op::OP_8XY6, 0xf00f, 0x8006, "op_8xy6", "SHR", "V{x}", &Chip8::op_8xy6, 0},
+            {Op::OP_8XY7, 0xf00f, 0x8007, "op_8xy7", "SUBN", "V{x}, V{y}", &Chip8::op_8xy7, 0},
+            {Op::OP_8XYE, 0xf00f, 0x800e, "op_8xye", "SHL", "V{x}", &Chip8::op_8xye, 0},
+            {Op::OP_9XY0, 0xf00f, 0x9000, "op_9xy0", "SNE", "V{x}, V{y}", &Chip8::op_9xy0, ISA_SKIP},
+            {Op::OP_ANNN, 0xf000, 0xa000, "op_annn", "LD", "I, {nnn}", &Chip8::op_annn, 0},
+            {Op::OP_BNNN, 0xf000, 0xb000, "op_bnnn", "JP", "V0, {nnn}", &Chip8::op_bnnn, ISA_BRANCH},
+            {Op::OP_CXKK, 0xf000, 0xc000, "op_cxkk", "RND", "V{x}, {kk}", &Chip8::op_cxkk, 0},
+            {Op::OP_DXYN, 0xf000, 0xd000, "op_dxyn", "DRW", "V{x}, V{y}, {n}", &Chip8::op_dxyn, 0},
+            {Op::OP_EX9E, 0xf0ff, 0xe09e, "op_ex9e", "SKP", "V{x}", &Chip8::op_ex9e, ISA_SKIP},
+            {Op::OP_EXA1, 0xf0ff, 0xe0a1, "op_exa1", "SKNP", "V{x}", &Chip8::op_exa1, ISA_SKIP},
+            {Op::OP_FX07, 0xf0ff, 0xf007, "op_fx07", "LD", "V{x}, DT", &Chip8::op_fx07, 0},
+            {Op::OP_FX0A, 0xf0ff, 0xf00a, "op_fx0a", "LD", "V{x}, K", &Chip8::op_fx0a, 0},
+            {Op::OP_FX15, 0xf0ff, 0xf015, "op_fx15", "LD", "DT, V{x}", &Chip8::op_fx15, 0},
+            {Op::OP_FX18, 0xf0ff, 0xf018, "op_fx18", "LD", "ST, V{x}", &Chip8::op_fx18, 0},
+            {Op::OP_FX1E, 0xf0ff, 0xf01e, "op_fx1e", "ADD", "I, V{x}", &Chip8::op_fx1e, 0},
+            {Op::OP_FX29, 0xf0ff, 0xf029, "op_fx29", "LD", "F, V{x}", &Chip8::op_fx29, 0},
+            {Op::OP_FX33, 0xf0ff, 0xf033, "op_fx33", "LD", "B, V{x}", &Chip8::op_fx33, 0},
+            {Op::OP_FX55, 0xf0ff, 0xf055, "op_fx55", "LD", "[I], V{x}", &Chip8::op_fx55, 0},
+            {Op::OP_FX65, 0xf0ff, 0xf065, "op_fx65", "LD", "V{x}, [I]", &Chip8::op_fx65, 0},
+        };
+
+        static constexpr unsigned int COUNT = sizeof(TABLE) / sizeof(TABLE[0]);
+
+        static constexpr const OpInfo &info(Op op) { return TABLE[static_cast<unsigned int>(op)]; }
+};
+
+// Perfect hash for decoding. The key is the high nibble and the low byte,
+// the only bits any mask tests besides the x nibble of 00E0/00EE. Each
+// key holds the most specific instruction that can match, plus the x nibble
+// it needs and what to decode instead when that differs.
+const uint16_t ISA_KEY_BITS = 0xf0ffu;
+
+constexpr unsigned int isa_key(uint16_t opcode)
+{
+        return ((opcode >> 4) & 0xf00u) | (opcode & 0xffu);
+}
+
+struct IsaSlot
+{
+        Op op;
+        Op fallback;
+        uint8_t x_mask;
+        uint8_t x_match;
+};
+
+constexpr unsigned int isa_specificity(uint16_t mask)
+{
+        return __builtin_popcount(mask);
+}
+
+constexpr std::array<IsaSlot, 4096> isa_build_slots()
+{
+        std::array<IsaSlot, 4096> slots{};
+        for (unsigned int key = 0; key < slots.size(); ++key)
+        {
+                uint16_t opcode = ((key & 0xf00u) << 4) | (key & 0xffu);
+                const OpInfo *best = &Isa::TABLE[0];
+                const OpInfo *best_without_x = &Isa::TABLE[0];
+                for (const OpInfo &info : Isa::TABLE)
+                {
+                        if ((opcode & info.mask & ISA_KEY_BITS) != (info.match & ISA_KEY_BITS))
+                        {
+                                continue;
+                        }
+                        if (isa_specificity(info.mask) > isa_specificity(best->mask))
+                        {
+                                best = &info;
+                        }
+                        if ((info.mask & ~ISA_KEY_BITS) == 0 &&
+                            isa_specificity(info.mask) > isa_specificity(best_without_x->mask))
+                        {
+                                best_without_x = &info;
+                        }
+                }
+                slots[key] = {best->op, best_without_x->op, static_cast<uint8_t>((best->mask >> 8) & 0xfu),
+                              static_cast<uint8_t>((best->match >> 8) & 0xfu)};
+        }
+        return slots;
+}
+
+inline constexpr std::array<IsaSlot, 4096> ISA_SLOTS = isa_build_slots();
+
+constexpr Op isa_decode(uint16_t opcode)
+{
+        IsaSlot slot = ISA_SLOTS[isa_key(opcode)];
+        return (((opcode >> 8) & slot.x_mask) == slot.x_match) ? slot.op : slot.fallback;
+}
+
+// The table is in Op order, and matching at most one pattern that needs the
+// x nibble per key is what makes the two-way slot exact
+constexpr bool isa_consistent()
+{
+        for (unsigned int i = 0; i < Isa::COUNT; ++i)
+        {
+                if (static_cast<unsigned int>(Isa::TABLE[i].op) != i)
+                {
+                        return false;
+                }
+        }
+        for (unsigned int key = 0; key < 4096; ++key)
+        {
+                uint16_t opcode = ((key & 0xf00u) << 4) | (key & 0xffu);
+                unsigned int needing_x = 0;
+                for (const OpInfo &info : Isa::TABLE)
+                {
+                        if ((opcode & info.mask & ISA_KEY_BITS) == (info.match & ISA_KEY_BITS) &&
+                            (info.mask & ~ISA_KEY_BITS) != 0)
+                        {
+                                ++needing_x;
+                        }
+                }
+                if (needing_x > 1)
+                {
+                        return false;
+                }
+        }
+        return true;
+}
+
+static_assert(isa_consistent(), "Isa::TABLE is out of Op order or defeats the decode hash");
+static_assert(isa_decode(0x00e0) == Op::OP_00E0 && isa_decode(0x00ee) == Op::OP_00EE &&
+              isa_decode(0x01e0) == Op::OP_0NNN && isa_decode(0xe19e) == Op::OP_EX9E &&
+              isa_decode(0xe1a2) == Op::OP_NONE && isa_decode(0x5121) == Op::OP_NONE);
+
+// Dispatch table: one plain function per instruction that calls its handler,
+// so Chip8::cycle makes a single indirect call
+using OpFunction = void (*)(Chip8 &chip8, uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn);
+
+template <Handler handler>
+void isa_invoke(Chip8 &chip8, uint8_t x, uint8_t y, uint8_t n, uint16_t kk, uint16_t nnn)
+{
+        (chip8.*handler)(x, y, n, kk, nnn);
+}
+
+template <unsigned int... I>
+constexpr std::array<OpFunction, Isa::COUNT> isa_build_dispatch(std::integer_sequence<unsigned int, I...>)
+{
+        return {&isa_invoke<Isa::TABLE[I].handler>...};
+}
+
+inline constexpr std::array<OpFunction, Isa::COUNT> ISA_DISPATCH =
+    isa_build_dispatch(std::make_integer_sequence<unsigned int, Isa::COUNT>());
+
+// Disassembly, e.g. "LD V3, 0x1f"
+std::string disassemble(uint16_t opcode);
+
+// Appends one "addr  opcode  instruction" line per two bytes of code, which
+// starts at address; a trailing odd byte is listed as data
+void disassemble(const uint8_t *code, size_t size, uint16_t address, std::string &text);
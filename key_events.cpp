@@ -0,0 +1,88 @@
+#include "key_events.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+uint64_t input_clock_ns()
+{
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+void InputLatency::Stage::add(uint64_t ns)
+{
+        ++count;
+        total_ns += ns;
+        max_ns = std::max(max_ns, ns);
+}
+
+std::string InputLatency::report() const
+{
+        char text[256];
+        std::snprintf(text, sizeof(text),
+                      "input latency over %llu presses (avg/max us):\n"
+                      "  applied   %10.1f %10.1f\n"
+                      "  read      %10.1f %10.1f\n"
+                      "  presented %10.1f %10.1f\n",
+                      (unsigned long long)queued.count, queued.average_us(), queued.max_ns / 1000.0,
+                      observed.average_us(), observed.max_ns / 1000.0, presented.average_us(),
+                      presented.max_ns / 1000.0);
+        return text;
+}
+
+bool KeyEventQueue::push(KeyEvent event)
+{
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) == CAPACITY)
+        {
+                return false;
+        }
+        events[position % CAPACITY] = event;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+}
+
+bool KeyEventQueue::pop(KeyEvent &event)
+{
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire))
+        {
+                return false;
+        }
+        event = events[position % CAPACITY];
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+}
+
+void KeyEventQueue::applied(const KeyEvent &event, uint64_t now)
+{
+        if (event.down)
+        {
+                latency.queued.add(now - event.time_ns);
+                pressed_at[event.key & 0xfu] = event.time_ns;
+        }
+}
+
+void KeyEventQueue::observed(uint8_t key, uint64_t now)
+{
+        uint64_t &pressed = pressed_at[key & 0xfu];
+        if (pressed)
+        {
+                latency.observed.add(now - pressed);
+                observed_pending[key & 0xfu] = pressed;
+                pressed = 0;
+        }
+}
+
+void KeyEventQueue::presented(uint64_t now)
+{
+        for (uint64_t &pressed : observed_pending)
+        {
+                if (pressed)
+                {
+                        latency.presented.add(now - pressed);
+                        pressed = 0;
+                }
+        }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <string>
+
+// Nanoseconds on the steady clock, the timebase of every KeyEvent
+uint64_t input_clock_ns();
+
+struct KeyEvent
+{
+        uint64_t time_ns;          // when the host saw the key change
+        uint8_t key;
+        bool down;
+};
+
+// Press-to-screen latency of keys, split into the three hops a press takes.
+// Filled in on the emulation thread.
+struct InputLatency
+{
+        struct Stage
+        {
+                uint64_t count{};
+                uint64_t total_ns{};
+                uint64_t max_ns{};
+
+                void add(uint64_t ns);
+                double average_us() const { return count ? total_ns / 1000.0 / count : 0; }
+        };
+
+        Stage queued;              // host event to the instruction boundary that applied it
+        Stage observed;            // host event to the first Ex9E/ExA1/Fx0A that read it
+        Stage presented;           // host event to the first frame shown after that read
+
+        std::string report() const;
+};
+
+// Single producer, single consumer queue of keypad events. The frontend
+// pushes as it polls the host; Chip8 drains it at instruction boundaries, so
+// a press takes effect on the next instruction rather than the next frame.
+class KeyEventQueue
+{
+public:
+        static const unsigned int CAPACITY = 256;
+
+        // Producer side; returns false and drops the event if the queue is full
+        bool push(KeyEvent event);
+
+        // Consumer side
+        bool pop(KeyEvent &event);
+        bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed); }
+
+        // Called by Chip8 when a press is applied and when a program first
+        // reads it, and by the frontend once a frame including it is shown
+        void applied(const KeyEvent &event, uint64_t now);
+        void observed(uint8_t key, uint64_t now);
+        void presented(uint64_t now);
+
+        InputLatency latency;
+
+private:
+        std::array<KeyEvent, CAPACITY> events{};
+        alignas(64) std::atomic<uint32_t> head{0};     // written by push()
+        alignas(64) std::atomic<uint32_t> tail{0};     // written by pop()
+
+        std::array<uint64_t, 16> pressed_at{};         // host time of presses not yet read
+        std::array<uint64_t, 16> observed_pending{};   // host time of presses read but not yet shown
+};
@@ -1,12 +1,17 @@
 #include "chip8.h"
 #include "platform.h"
+#include "recorder.h"
+#include "runahead.h"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cstdlib>
+#include <memory>
 
 int main(int argc, char ** argv)
 {
-	if (argc != 4) {
-		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
+	if (argc != 4 && argc != 5) {
+		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM> [Record.gif|.png|.c8r]\n";
 		std::exit(EXIT_FAILURE);
 	}
 
@@ -14,18 +19,99 @@ int main(int argc, char ** argv)
 	int cycle_delay = std::stoi(argv[2]);
 	char const* rom_file_name = argv[3];
 
+	// Instances all start from one seed; play a different game each run
 	Chip8 chip8;
+	chip8.seed(std::chrono::system_clock::now().time_since_epoch().count());
 	chip8.load_rom(rom_file_name);
 
+	// Frames are encoded on the recorder's own thread
+	Recorder recorder;
+	if (argc == 5 && !recorder.open(argv[4], record_format_for(argv[4]))) {
+		std::cerr << "Could not write " << argv[4] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
 	Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * video_scale, VIDEO_HEIGHT * video_scale, VIDEO_WIDTH, VIDEO_HEIGHT);
 	int video_pitch = sizeof(chip8.display[0]) * VIDEO_WIDTH;
 
+	// CHIP8_METRICS=<Prefix> writes <Prefix>.prom and <Prefix>.json every second
+	std::unique_ptr<MetricsExporter> metrics;
+	if (char const* metrics_prefix = std::getenv("CHIP8_METRICS")) {
+		metrics = std::make_unique<MetricsExporter>(metrics_prefix, std::chrono::seconds(1));
+		metrics->watch(0, chip8);
+		metrics->start();
+	}
+
+	// CHIP8_RUNAHEAD=<Frames> shows each frame that many frames early, see RunAhead
+	std::unique_ptr<RunAhead> runahead;
+	if (char const* runahead_frames = std::getenv("CHIP8_RUNAHEAD")) {
+		char* end = nullptr;
+		long frames = std::strtol(runahead_frames, &end, 10);
+		if (end == runahead_frames || *end != '\0') {
+			std::cerr << "CHIP8_RUNAHEAD must be a number of frames, not \"" << runahead_frames << "\"\n";
+			std::exit(EXIT_FAILURE);
+		}
+		if (frames < 0 || frames > long(RUNAHEAD_MAX_FRAMES)) {
+			frames = std::clamp(frames, 0l, long(RUNAHEAD_MAX_FRAMES));
+			std::cerr << "CHIP8_RUNAHEAD clamped to " << frames << "\n";
+		}
+		if (frames > 0) {
+			runahead = std::make_unique<RunAhead>(frames);
+		}
+	}
+
+	// Key events reach the core at the next instruction boundary
+	KeyEventQueue input;
+	chip8.input = &input;
+	uint16_t held_keys = 0;
+
 	auto lastCycleTime = std::chrono::high_resolution_clock::now();
 	bool quit = false;
 
+#ifdef CHIP8_VIP_TIMING
+	// Instruction costs pace the core, one field per 60 Hz tick
+	(void)cycle_delay;
+	const auto frame_time = std::chrono::microseconds(16667);
+
 	while (!quit)
 	{
-		quit = platform.ProcessInput(chip8.keypad.data());
+		quit = platform.ProcessInput(held_keys, &input);
+
+		auto currentTime = std::chrono::high_resolution_clock::now();
+
+		if (currentTime - lastCycleTime >= frame_time) {
+			uint64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(currentTime - lastCycleTime - frame_time).count();
+			metric_tick(lag);
+			lastCycleTime += frame_time;
+			// Don't try to catch up after a long stall
+			if (currentTime - lastCycleTime > 4 * frame_time) {
+				lastCycleTime = currentTime;
+			}
+			chip8.run_frame();
+			if (runahead) {
+				runahead->speculate(chip8);
+			}
+			platform.Update(chip8.display.data(), video_pitch);
+			input.presented(input_clock_ns());
+			metric_add(METRIC_PRESENTS);
+			if (runahead) {
+				runahead->rollback(chip8);
+			}
+			recorder.push(chip8.display.data(), video_pitch);
+		}
+	}
+#else
+	const auto frame_time = std::chrono::microseconds(16667);
+	auto lastFrameTime = lastCycleTime;
+	InstanceCounters flushed = chip8.counters;
+	// Speculative frames run as many instructions as a 60 Hz frame gets here
+	if (cycle_delay > 0) {
+		chip8.instructions_per_frame = std::max(1, 1000 / (60 * cycle_delay));
+	}
+
+	while (!quit)
+	{
+		quit = platform.ProcessInput(held_keys, &input);
 
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
@@ -33,8 +119,44 @@ int main(int argc, char ** argv)
 		if (dt > cycle_delay) {
 			lastCycleTime = currentTime;
 			chip8.cycle();
-			platform.Update(chip8.display.data(), video_pitch);
+			// With run-ahead the display is only shown at 60 Hz
+			if (!runahead) {
+				platform.Update(chip8.display.data(), video_pitch);
+				input.presented(input_clock_ns());
+				metric_add(METRIC_PRESENTS);
+			}
+		}
+
+		// Recordings sample the display, taps age and counters flush at 60 Hz
+		// whatever the cycle rate
+		if (currentTime - lastFrameTime >= frame_time) {
+			uint64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(currentTime - lastFrameTime - frame_time).count();
+			metric_tick(lag);
+			lastFrameTime += frame_time;
+			if (currentTime - lastFrameTime > 4 * frame_time) {
+				lastFrameTime = currentTime;
+			}
+			recorder.push(chip8.display.data(), video_pitch);
+			chip8.age_keys();
+			metric_flush(chip8.counters, flushed);
+			if (runahead) {
+				runahead->speculate(chip8);
+				platform.Update(chip8.display.data(), video_pitch);
+				input.presented(input_clock_ns());
+				metric_add(METRIC_PRESENTS);
+				runahead->rollback(chip8);
+			}
 		}
 	}
+#endif
+
+	std::cout << input.latency.report();
+	if (runahead) {
+		std::cout << runahead->report();
+	}
+
+	if (!recorder.close()) {
+		std::cerr << "Could not write " << argv[4] << "\n";
+	}
 	return 0;
 }
@@ -0,0 +1,280 @@
+#include "metrics.h"
+#include "chip8.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+enum MetricKind { SUM, MAX };
+
+struct MetricInfo
+{
+        const char *name;
+        const char *help;
+        MetricKind kind;
+};
+
+static const MetricInfo METRIC_INFO[METRIC_COUNT] = {
+    {"chip8_instructions_total", "Instructions executed", SUM},
+    {"chip8_frames_total", "Frames run", SUM},
+    {"chip8_draws_total", "Dxyn sprite draws", SUM},
+    {"chip8_collisions_total", "Dxyn draws that erased a pixel", SUM},
+    {"chip8_idle_frames_total", "Frames that ended waiting for a key", SUM},
+    {"chip8_aot_compiled_total", "Instructions run in recompiled code", SUM},
+    {"chip8_aot_interpreted_total", "Instructions aot_run interpreted", SUM},
+    {"chip8_hash_pages_reused_total", "Memory pages state_hash reused", SUM},
+    {"chip8_hash_pages_hashed_total", "Memory pages state_hash rehashed", SUM},
+    {"chip8_ticks_total", "Frame ticks of the scheduler and frontend loops", SUM},
+    {"chip8_tick_lag_nanoseconds_total", "Summed lateness of frame ticks", SUM},
+    {"chip8_tick_lag_max_nanoseconds", "Worst lateness of any frame tick since the process started", MAX},
+    {"chip8_presents_total", "Frames presented by the frontend", SUM},
+    {"chip8_speculative_frames_total", "Frames run ahead and rolled back", SUM},
+};
+
+// One per thread that records anything. Shards are never freed, so counts
+// from threads that exited stay in the totals.
+struct alignas(64) MetricsShard
+{
+        std::array<std::atomic<uint64_t>, METRIC_COUNT> values{};
+        MetricsShard *next{nullptr};
+};
+
+static std::atomic<MetricsShard *> shards{nullptr};
+static thread_local MetricsShard *local_shard = nullptr;
+
+static MetricsShard &shard()
+{
+        if (!local_shard)
+        {
+                local_shard = new MetricsShard;
+                local_shard->next = shards.load(std::memory_order_relaxed);
+                while (!shards.compare_exchange_weak(local_shard->next, local_shard, std::memory_order_release,
+                                                     std::memory_order_relaxed))
+                {
+                }
+        }
+        return *local_shard;
+}
+
+// Only the owning thread writes a shard, so a load and a store are enough
+void metric_add(Metric metric, uint64_t amount)
+{
+        std::atomic<uint64_t> &value = shard().values[metric];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void metric_max(Metric metric, uint64_t candidate)
+{
+        std::atomic<uint64_t> &value = shard().values[metric];
+        if (candidate > value.load(std::memory_order_relaxed))
+        {
+                value.store(candidate, std::memory_order_relaxed);
+        }
+}
+
+void metric_tick(uint64_t lag_ns)
+{
+        metric_add(METRIC_TICKS);
+        metric_add(METRIC_TICK_LAG_NS, lag_ns);
+        metric_max(METRIC_TICK_LAG_MAX_NS, lag_ns);
+}
+
+void metric_flush(const InstanceCounters &now, InstanceCounters &last)
+{
+        MetricsShard &local = shard();
+        auto flush = [&local](Metric metric, uint64_t current, uint64_t &previous) {
+                if (current != previous)
+                {
+                        std::atomic<uint64_t> &value = local.values[metric];
+                        value.store(value.load(std::memory_order_relaxed) + (current - previous), std::memory_order_relaxed);
+                        previous = current;
+                }
+        };
+        flush(METRIC_INSTRUCTIONS, now.instructions, last.instructions);
+        flush(METRIC_FRAMES, now.frames, last.frames);
+        flush(METRIC_DRAWS, now.draws, last.draws);
+        flush(METRIC_COLLISIONS, now.collisions, last.collisions);
+        flush(METRIC_IDLE_FRAMES, now.idle_frames, last.idle_frames);
+}
+
+MetricsSnapshot metrics_snapshot()
+{
+        MetricsSnapshot snapshot;
+        for (MetricsShard *s = shards.load(std::memory_order_acquire); s; s = s->next)
+        {
+                for (unsigned int i = 0; i < METRIC_COUNT; ++i)
+                {
+                        uint64_t value = s->values[i].load(std::memory_order_relaxed);
+                        snapshot.values[i] =
+                            (METRIC_INFO[i].kind == MAX) ? std::max(snapshot.values[i], value) : snapshot.values[i] + value;
+                }
+        }
+        return snapshot;
+}
+
+MetricsExporter::MetricsExporter(std::string prefix, std::chrono::milliseconds interval)
+    : prefix(prefix), interval(interval)
+{
+        previous = metrics_snapshot();
+        previous_time = start_time = std::chrono::steady_clock::now();
+}
+
+MetricsExporter::~MetricsExporter()
+{
+        stop();
+}
+
+void MetricsExporter::watch(unsigned int id, const Chip8 &chip8)
+{
+        instances.emplace_back(id, &chip8);
+}
+
+void MetricsExporter::start()
+{
+        if (!worker.joinable())
+        {
+                stopping = false;
+                worker = std::thread(&MetricsExporter::loop, this);
+        }
+}
+
+void MetricsExporter::stop()
+{
+        if (!worker.joinable())
+        {
+                return;
+        }
+        {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+        write();
+}
+
+void MetricsExporter::loop()
+{
+        std::unique_lock<std::mutex> guard(lock);
+        while (!wake.wait_for(guard, interval, [this]() { return stopping; }))
+        {
+                guard.unlock();
+                write();
+                guard.lock();
+        }
+}
+
+static double ratio(uint64_t part, uint64_t whole)
+{
+        return whole ? double(part) / whole : 0;
+}
+
+bool MetricsExporter::write()
+{
+        MetricsSnapshot now = metrics_snapshot();
+        auto now_time = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now_time - previous_time).count();
+        double uptime = std::chrono::duration<double>(now_time - start_time).count();
+        auto delta = [&](Metric metric) { return now.values[metric] - previous.values[metric]; };
+        auto &v = now.values;
+
+        struct Gauge
+        {
+                const char *name;
+                const char *help;
+                double value;
+        };
+        const Gauge gauges[] = {
+            {"chip8_instructions_per_second", "Instructions per second over the last interval",
+             seconds > 0 ? delta(METRIC_INSTRUCTIONS) / seconds : 0},
+            {"chip8_frames_per_second", "Frames per second over the last interval",
+             seconds > 0 ? delta(METRIC_FRAMES) / seconds : 0},
+            {"chip8_idle_skip_ratio", "Share of frames that ended parked on Fx0A",
+             ratio(v[METRIC_IDLE_FRAMES], v[METRIC_FRAMES])},
+            {"chip8_aot_hit_ratio", "Share of aot_run instructions served by recompiled code",
+             ratio(v[METRIC_AOT_COMPILED], v[METRIC_AOT_COMPILED] + v[METRIC_AOT_INTERPRETED])},
+            {"chip8_hash_page_hit_ratio", "Share of memory pages state_hash reused",
+             ratio(v[METRIC_HASH_PAGES_REUSED], v[METRIC_HASH_PAGES_REUSED] + v[METRIC_HASH_PAGES_HASHED])},
+            {"chip8_tick_lag_average_seconds", "Average lateness of frame ticks",
+             ratio(v[METRIC_TICK_LAG_NS], v[METRIC_TICKS]) / 1e9},
+            {"chip8_uptime_seconds", "Seconds since the exporter started", uptime},
+        };
+
+        std::ostringstream prom;
+        std::ostringstream json;
+        json << "{\"uptime\":" << uptime;
+        for (unsigned int i = 0; i < METRIC_COUNT; ++i)
+        {
+                const MetricInfo &info = METRIC_INFO[i];
+                prom << "# HELP " << info.name << " " << info.help << "\n";
+                prom << "# TYPE " << info.name << ((info.kind == SUM) ? " counter\n" : " gauge\n");
+                prom << info.name << " " << v[i] << "\n";
+                json << ",\"" << info.name << "\":" << v[i];
+        }
+        for (const Gauge &gauge : gauges)
+        {
+                prom << "# HELP " << gauge.name << " " << gauge.help << "\n";
+                prom << "# TYPE " << gauge.name << " gauge\n";
+                prom << gauge.name << " " << gauge.value << "\n";
+                json << ",\"" << gauge.name << "\":" << gauge.value;
+        }
+
+        if (!instances.empty())
+        {
+                static const char *const INSTANCE_SERIES[] = {"instructions", "frames", "draws", "collisions",
+                                                              "idle_frames"};
+                const unsigned int SERIES_COUNT = 5;
+
+                std::vector<std::array<uint64_t, SERIES_COUNT>> values(instances.size());
+                json << ",\"instances\":[";
+                for (size_t i = 0; i < instances.size(); ++i)
+                {
+                        const InstanceCounters &c = instances[i].second->counters;
+                        values[i] = {read_counter(c.instructions), read_counter(c.frames), read_counter(c.draws),
+                                     read_counter(c.collisions), read_counter(c.idle_frames)};
+                        json << (i ? "," : "") << "{\"id\":" << instances[i].first;
+                        for (unsigned int series = 0; series < SERIES_COUNT; ++series)
+                        {
+                                json << ",\"" << INSTANCE_SERIES[series] << "\":" << values[i][series];
+                        }
+                        json << "}";
+                }
+                json << "]";
+
+                for (unsigned int series = 0; series < SERIES_COUNT; ++series)
+                {
+                        prom << "# HELP chip8_instance_" << INSTANCE_SERIES[series] << "_total Per-instance "
+                             << INSTANCE_SERIES[series] << "\n";
+                        prom << "# TYPE chip8_instance_" << INSTANCE_SERIES[series] << "_total counter\n";
+                        for (size_t i = 0; i < instances.size(); ++i)
+                        {
+                                prom << "chip8_instance_" << INSTANCE_SERIES[series] << "_total{chip8_instance=\""
+                                     << instances[i].first << "\"} " << values[i][series] << "\n";
+                        }
+                }
+        }
+        json << "}\n";
+
+        previous = now;
+        previous_time = now_time;
+
+        // Readers never see a half-written exposition file
+        std::string temporary = prefix + ".prom.tmp";
+        {
+                std::ofstream file(temporary, std::ios::trunc);
+                file << prom.str();
+                if (!file.good())
+                {
+                        return false;
+                }
+        }
+        if (std::rename(temporary.c_str(), (prefix + ".prom").c_str()) != 0)
+        {
+                return false;
+        }
+
+        std::ofstream log(prefix + ".json", std::ios::app);
+        log << json.str();
+        return log.good();
+}
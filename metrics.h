@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Chip8;
+
+// Counters one instance keeps for itself. The owning thread bumps them with
+// count(); any thread may read them with read_counter().
+struct InstanceCounters
+{
+        uint64_t instructions{};
+        uint64_t frames{};
+        uint64_t draws{};
+        uint64_t collisions{};
+        uint64_t idle_frames{};    // frames that ended waiting on Fx0A
+};
+
+inline void count(uint64_t &counter, uint64_t amount = 1)
+{
+        std::atomic_ref<uint64_t>(counter).store(counter + amount, std::memory_order_relaxed);
+}
+
+inline uint64_t read_counter(const uint64_t &counter)
+{
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(counter)).load(std::memory_order_relaxed);
+}
+
+// Process-wide metrics. Each thread adds into its own shard; a snapshot sums
+// the shards, so recording never takes a lock or shares a cache line.
+enum Metric
+{
+        METRIC_INSTRUCTIONS,
+        METRIC_FRAMES,
+        METRIC_DRAWS,
+        METRIC_COLLISIONS,
+        METRIC_IDLE_FRAMES,
+        METRIC_AOT_COMPILED,       // instructions aot_run executed in recompiled code
+        METRIC_AOT_INTERPRETED,    // instructions it fell back to Chip8::cycle for
+        METRIC_HASH_PAGES_REUSED,  // clean memory pages state_hash did not rehash
+        METRIC_HASH_PAGES_HASHED,
+        METRIC_TICKS,              // frame ticks of the scheduler and frontend loops
+        METRIC_TICK_LAG_NS,        // how late those ticks fired, summed
+        METRIC_TICK_LAG_MAX_NS,    // the worst of them since the process started
+        METRIC_PRESENTS,
+        METRIC_SPECULATIVE_FRAMES, // frames run ahead and rolled back, also in METRIC_FRAMES
+        METRIC_COUNT
+};
+
+void metric_add(Metric metric, uint64_t amount = 1);
+void metric_max(Metric metric, uint64_t value);
+// Records a frame tick that fired lag_ns late
+void metric_tick(uint64_t lag_ns);
+
+// Adds what an instance counted since last into the calling thread's shard
+void metric_flush(const InstanceCounters &now, InstanceCounters &last);
+
+struct MetricsSnapshot
+{
+        std::array<uint64_t, METRIC_COUNT> values{};
+};
+
+MetricsSnapshot metrics_snapshot();
+
+// Periodically writes <prefix>.prom, a Prometheus text exposition file
+// replaced atomically for a textfile collector, and appends one JSON object
+// per interval to <prefix>.json. Rates cover the interval since the previous
+// write.
+class MetricsExporter
+{
+public:
+        MetricsExporter(std::string prefix, std::chrono::milliseconds interval);
+        ~MetricsExporter();
+
+        // Adds per-instance series; chip8 must outlive the exporter
+        void watch(unsigned int id, const Chip8 &chip8);
+
+        void start();
+        // Stops the thread and writes a final sample
+        void stop();
+        bool write();
+
+private:
+        void loop();
+
+        std::string prefix;
+        std::chrono::milliseconds interval;
+        std::vector<std::pair<unsigned int, const Chip8 *>> instances;
+
+        MetricsSnapshot previous;
+        std::chrono::steady_clock::time_point previous_time;
+        std::chrono::steady_clock::time_point start_time;
+
+        std::thread worker;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping{false};
+};
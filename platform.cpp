@@ -1,13 +1,24 @@
 #include "platform.h"
 #include <SDL2/SDL.h>
 
-Platform::Platform(char const *title, int windowWidth, int windowHeight, int textureWidth, int textureHeight)
+// Host key for each CHIP-8 key, laid out as the left side of a QWERTY keyboard:
+//   1 2 3 4        1 2 3 C
+//   Q W E R   ->   4 5 6 D
+//   A S D F        7 8 9 E
+//   Z X C V        A 0 B F
+static const SDL_Keycode KEYMAP[16] = {
+    SDLK_x, SDLK_1, SDLK_2, SDLK_3, SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+    SDLK_s, SDLK_d, SDLK_z, SDLK_c, SDLK_4, SDLK_r, SDLK_f, SDLK_v,
+};
+
+Platform::Platform(char const *title, int windowWidth, int windowHeight, int textureWidth, int textureHeight,
+                   bool vsync)
 {
         SDL_Init(SDL_INIT_VIDEO);
 
         window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
 
-        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 
         texture = SDL_CreateTexture(
             renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
@@ -29,7 +40,30 @@ void Platform::Update(void const *buffer, int pitch)
         SDL_RenderPresent(renderer);
 }
 
-bool Platform::ProcessInput(uint8_t *keys)
+void Platform::UpdateRect(int x, int y, int width, int height, void const *pixels, int pitch)
+{
+        SDL_Rect rect{x, y, width, height};
+        SDL_UpdateTexture(texture, &rect, pixels, pitch);
+}
+
+void Platform::Present()
+{
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+}
+
+int Platform::RefreshRate() const
+{
+        SDL_DisplayMode mode;
+        if (SDL_GetWindowDisplayMode(window, &mode) != 0 || mode.refresh_rate <= 0)
+        {
+                return 60;
+        }
+        return mode.refresh_rate;
+}
+
+bool Platform::ProcessInput(uint16_t &keys, KeyEventQueue *events)
 {
         bool quit = false;
 
@@ -37,225 +71,38 @@ bool Platform::ProcessInput(uint8_t *keys)
 
         while (SDL_PollEvent(&event))
         {
-                switch (event.type)
-                {
-                case SDL_QUIT:
+                if (event.type == SDL_QUIT)
                 {
                         quit = true;
+                        continue;
                 }
-                break;
-
-                case SDL_KEYDOWN:
+                if ((event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) || event.key.repeat)
                 {
-                        switch (event.key.keysym.sym)
-                        {
-                        case SDLK_ESCAPE:
-                        {
-                                quit = true;
-                        }
-                        break;
-
-                        case SDLK_x:
-                        {
-                                keys[0] = 1;
-                        }
-                        break;
-
-                        case SDLK_1:
-                        {
-                                keys[1] = 1;
-                        }
-                        break;
-
-                        case SDLK_2:
-                        {
-                                keys[2] = 1;
-                        }
-                        break;
-
-                        case SDLK_3:
-                        {
-                                keys[3] = 1;
-                        }
-                        break;
-
-                        case SDLK_q:
-                        {
-                                keys[4] = 1;
-                        }
-                        break;
-
-                        case SDLK_w:
-                        {
-                                keys[5] = 1;
-                        }
-                        break;
-
-                        case SDLK_e:
-                        {
-                                keys[6] = 1;
-                        }
-                        break;
-
-                        case SDLK_a:
-                        {
-                                keys[7] = 1;
-                        }
-                        break;
-
-                        case SDLK_s:
-                        {
-                                keys[8] = 1;
-                        }
-                        break;
-
-                        case SDLK_d:
-                        {
-                                keys[9] = 1;
-                        }
-                        break;
-
-                        case SDLK_z:
-                        {
-                                keys[0xA] = 1;
-                        }
-                        break;
-
-                        case SDLK_c:
-                        {
-                                keys[0xB] = 1;
-                        }
-                        break;
-
-                        case SDLK_4:
-                        {
-                                keys[0xC] = 1;
-                        }
-                        break;
-
-                        case SDLK_r:
-                        {
-                                keys[0xD] = 1;
-                        }
-                        break;
-
-                        case SDLK_f:
-                        {
-                                keys[0xE] = 1;
-                        }
-                        break;
-
-                        case SDLK_v:
-                        {
-                                keys[0xF] = 1;
-                        }
-                        break;
-                        }
+                        continue;
                 }
-                break;
 
-                case SDL_KEYUP:
+                bool down = event.type == SDL_KEYDOWN;
+                if (down && event.key.keysym.sym == SDLK_ESCAPE)
                 {
-                        switch (event.key.keysym.sym)
-                        {
-                        case SDLK_x:
-                        {
-                                keys[0] = 0;
-                        }
-                        break;
-
-                        case SDLK_1:
-                        {
-                                keys[1] = 0;
-                        }
-                        break;
-
-                        case SDLK_2:
-                        {
-                                keys[2] = 0;
-                        }
-                        break;
-
-                        case SDLK_3:
-                        {
-                                keys[3] = 0;
-                        }
-                        break;
-
-                        case SDLK_q:
-                        {
-                                keys[4] = 0;
-                        }
-                        break;
-
-                        case SDLK_w:
-                        {
-                                keys[5] = 0;
-                        }
-                        break;
-
-                        case SDLK_e:
-                        {
-                                keys[6] = 0;
-                        }
-                        break;
-
-                        case SDLK_a:
-                        {
-                                keys[7] = 0;
-                        }
-                        break;
-
-                        case SDLK_s:
-                        {
-                                keys[8] = 0;
-                        }
-                        break;
-
-                        case SDLK_d:
-                        {
-                                keys[9] = 0;
-                        }
-                        break;
-
-                        case SDLK_z:
-                        {
-                                keys[0xA] = 0;
-                        }
-                        break;
-
-                        case SDLK_c:
-                        {
-                                keys[0xB] = 0;
-                        }
-                        break;
-
-                        case SDLK_4:
-                        {
-                                keys[0xC] = 0;
-                        }
-                        break;
-
-                        case SDLK_r:
-                        {
-                                keys[0xD] = 0;
-                        }
-                        break;
+                        quit = true;
+                }
 
-                        case SDLK_f:
+                for (unsigned int key = 0; key < sizeof(KEYMAP) / sizeof(KEYMAP[0]); ++key)
+                {
+                        if (KEYMAP[key] != event.key.keysym.sym)
                         {
-                                keys[0xE] = 0;
+                                continue;
                         }
-                        break;
 
-                        case SDLK_v:
+                        uint16_t bit = 1u << key;
+                        keys = down ? (keys | bit) : (keys & ~bit);
+                        if (events)
                         {
-                                keys[0xF] = 0;
+                                // Back-date to when SDL queued the event
+                                uint64_t waited_ms = SDL_GetTicks() - event.key.timestamp;
+                                events->push(KeyEvent{input_clock_ns() - waited_ms * 1000000, uint8_t(key), down});
                         }
                         break;
-                        }
-                }
-                break;
                 }
         }
 
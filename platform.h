@@ -1,5 +1,6 @@
 #pragma once
 
+#include "key_events.h"
 #include <cstdint>
 
 class SDL_Window;
@@ -9,10 +10,19 @@ class SDL_Texture;
 class Platform
 {
 public:
-        Platform(char const *title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
+        Platform(char const *title, int windowWidth, int windowHeight, int textureWidth, int textureHeight,
+                 bool vsync = false);
         ~Platform();
         void Update(void const *buffer, int pitch);
-        bool ProcessInput(uint8_t *keys);
+        // Uploads part of the texture without presenting, for callers that
+        // redraw a few regions per frame
+        void UpdateRect(int x, int y, int width, int height, void const *pixels, int pitch);
+        void Present();
+        // Refresh rate of the window's display in Hz, 60 if unknown
+        int RefreshRate() const;
+        // Tracks held keys as a bitmask and, given a queue, also sends each
+        // change as a timestamped event. Returns true when asked to quit.
+        bool ProcessInput(uint16_t &keys, KeyEventQueue *events = nullptr);
 
 private:
         SDL_Window *window{};
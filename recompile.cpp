@@ -0,0 +1,157 @@
+#include "analyzer.h"
+#include "isa.h"
+#include <cctype>
+#include <fstream>
+#include <iostream>
+
+// Enumerator name of an Op, e.g. OP_8XY4, derived from its handler's name
+static std::string enumerator(const OpInfo &info)
+{
+        if (info.op == Op::OP_NONE)
+        {
+                return "OP_NONE";
+        }
+        std::string name = "OP_";
+        for (const char *p = info.handler_name + 3; *p; ++p)
+        {
+                name += std::toupper(static_cast<unsigned char>(*p));
+        }
+        return name;
+}
+
+static void emit_block(std::ostream &out, const RomAnalysis &analysis, const BasicBlock &block, bool check_code)
+{
+        unsigned int count = (block.end - block.start) / 2;
+
+        out << "                        case 0x" << block.start << ":\n";
+        out << "                                if (budget - done < " << std::dec << count << std::hex << ")\n";
+        out << "                                        return done;\n";
+        if (check_code)
+        {
+                out << "                                if (std::memcmp(&c.memory[0x" << block.start << "], &rom_image[0x"
+                    << block.start - START_ADDRESS << "], " << std::dec << block.end - block.start << std::hex << ") != 0)\n";
+                out << "                                        return done;\n";
+        }
+
+        unsigned int executed = 0;
+        for (unsigned int addr = block.start; addr < block.end; addr += 2)
+        {
+                uint16_t opcode = (analysis.image[addr] << 8u) | analysis.image[addr + 1];
+                Instruction ins = decode(opcode);
+                const OpInfo &info = Isa::info(ins.op);
+                unsigned int next = addr + 2;
+                ++executed;
+
+                out << "                                c.pc = 0x" << next << ";";
+                if (ins.op != Op::OP_NONE)
+                {
+                        out << " c." << info.handler_name << "(0x" << +ins.x << ", 0x" << +ins.y << ", 0x" << +ins.n
+                            << ", 0x" << +ins.kk << ", 0x" << ins.nnn << ");";
+                }
+                out << " c.retire(Op::" << enumerator(info) << ", 0x" << opcode << ");\n";
+
+                // A store may have rewritten the rest of this block; leave it
+                // to the interpreter if so
+                if (check_code && (ins.op == Op::OP_FX33 || ins.op == Op::OP_FX55) && next < block.end)
+                {
+                        out << "                                if (std::memcmp(&c.memory[0x" << next << "], &rom_image[0x"
+                            << next - START_ADDRESS << "], " << std::dec << block.end - next << std::hex << ") != 0)\n";
+                        out << "                                {\n";
+                        out << "                                        done += " << std::dec << executed << std::hex << ";\n";
+                        out << "                                        return done;\n";
+                        out << "                                }\n";
+                }
+
+                // Fx0A rewinds pc while no key is down
+                if (ins.op == Op::OP_FX0A && next < block.end)
+                {
+                        out << "                                if (c.pc != 0x" << next << ")\n";
+                        out << "                                {\n";
+                        out << "                                        done += " << std::dec << executed << std::hex << ";\n";
+                        out << "                                        continue;\n";
+                        out << "                                }\n";
+                }
+        }
+
+        out << "                                done += " << std::dec << count << std::hex << ";\n";
+        out << "                                break;\n";
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc != 4) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Output.cpp> <Name>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::string name = argv[3];
+	for (char ch : name) {
+		if (!std::isalnum(static_cast<unsigned char>(ch)) && ch != '_') {
+			std::cerr << "Name must be a C++ identifier\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	RomAnalysis analysis;
+	if (!analysis.load_rom(argv[1])) {
+		std::cerr << "Could not read " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	// Only guard against modified code when a store might reach it
+	bool check_code = analysis.self_modifying;
+
+	std::ofstream out(argv[2]);
+	if (!out.is_open()) {
+		std::cerr << "Could not write " << argv[2] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	out << "// Generated by chip8-recompile from " << argv[1] << ", do not edit\n";
+	out << "#include \"aot.h\"\n";
+	out << "#include <cstring>\n\n";
+	out << "namespace\n{\n";
+	out << "struct " << name << "_tag;\n";
+	if (check_code) {
+		out << "const uint8_t rom_image[] = {";
+		for (unsigned int i = 0; i < analysis.rom_size; ++i) {
+			out << (i % 16 == 0 ? "\n    " : " ") << std::dec << +analysis.image[START_ADDRESS + i] << ",";
+		}
+		out << "\n};\n";
+	}
+	out << "}\n\n";
+
+	out << "template <>\n";
+	out << "struct Recompiled<" << name << "_tag>\n{\n";
+	out << "        static unsigned int run(Chip8 &c, unsigned int budget)\n";
+	out << "        {\n";
+	out << "                unsigned int done = 0;\n";
+	out << "                while (true)\n";
+	out << "                {\n";
+	out << "                        switch (c.pc)\n";
+	out << "                        {\n";
+	out << std::hex;
+	unsigned int emitted = 0;
+	for (auto const &[start, block] : analysis.blocks) {
+		// The guard compares against the ROM, so code outside it runs
+		// through Chip8::cycle
+		if (check_code && (block.start < START_ADDRESS || block.end > START_ADDRESS + analysis.rom_size)) {
+			continue;
+		}
+		emit_block(out, analysis, block, check_code);
+		++emitted;
+	}
+	out << "                        default:\n";
+	out << "                                return done;\n";
+	out << "                        }\n";
+	out << "                }\n";
+	out << "        }\n";
+	out << "};\n\n";
+
+	out << "unsigned int aot_" << name << "(Chip8 &c, unsigned int budget)\n{\n";
+	out << "        return Recompiled<" << name << "_tag>::run(c, budget);\n";
+	out << "}\n";
+
+	std::cout << std::dec << emitted << " of " << analysis.blocks.size() << " blocks written to " << argv[2] << "\n";
+	return 0;
+}
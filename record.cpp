@@ -0,0 +1,45 @@
+#include "input_script.h"
+#include "recorder.h"
+#include <iostream>
+
+int main(int argc, char ** argv)
+{
+	if (argc < 4 || argc > 5) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Output.gif|.png|.c8r> <Frames> [Input]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	char const *output = argv[2];
+	unsigned int frames = std::stoi(argv[3]);
+
+	InputScript input;
+	if (argc == 5 && !input.load(argv[4])) {
+		std::cerr << "Could not read " << argv[4] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	Chip8 chip8;
+	chip8.seed(1);
+	chip8.load_rom(argv[1]);
+
+	Recorder recorder;
+	recorder.lossless = true;
+	if (!recorder.open(output, record_format_for(output))) {
+		std::cerr << "Could not write " << output << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int video_pitch = sizeof(chip8.display[0]) * VIDEO_WIDTH;
+	for (unsigned int frame = 0; frame < frames; ++frame) {
+		input.apply(frame, chip8);
+		chip8.run_frame();
+		recorder.push(chip8.display.data(), video_pitch);
+	}
+
+	if (!recorder.close()) {
+		std::cerr << "Could not write " << output << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+	std::cout << recorder.frames() << " frames, " << recorder.dropped() << " dropped\n";
+	return 0;
+}
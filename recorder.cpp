@@ -0,0 +1,551 @@
+#include "recorder.h"
+
+#include <zlib.h>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+// Longest a single image is held before it is written out again, in frames
+const unsigned int MAX_REPEAT = 30000;
+
+const uint32_t ALL_ROWS = (VIDEO_HEIGHT >= 32) ? 0xffffffffu : (1u << VIDEO_HEIGHT) - 1;
+
+static_assert(VIDEO_WIDTH == 64 && VIDEO_HEIGHT <= 32, "rows are packed into u64 with a u32 change mask");
+
+RecordFormat record_format_for(std::string filename)
+{
+        auto ends_with = [&filename](const char *suffix) {
+                size_t length = std::strlen(suffix);
+                return filename.size() >= length && filename.compare(filename.size() - length, length, suffix) == 0;
+        };
+        if (ends_with(".gif"))
+        {
+                return RecordFormat::GIF;
+        }
+        if (ends_with(".png") || ends_with(".apng"))
+        {
+                return RecordFormat::APNG;
+        }
+        return RecordFormat::RAW;
+}
+
+// First and last row set in changed, or row 0 alone for an unchanged image
+static void changed_span(uint32_t changed, unsigned int &first, unsigned int &count)
+{
+        if (changed == 0)
+        {
+                first = 0;
+                count = 1;
+                return;
+        }
+        first = std::countr_zero(changed);
+        count = 32 - std::countl_zero(changed) - first;
+}
+
+class FrameEncoder
+{
+public:
+        virtual ~FrameEncoder() = default;
+
+        virtual bool begin(std::FILE *file) = 0;
+        // rows stays on screen for repeat frames; changed marks the rows
+        // that differ from the previous image
+        virtual bool frame(const FrameRows &rows, uint32_t changed, unsigned int repeat) = 0;
+        virtual bool finish() = 0;
+
+protected:
+        bool put(const void *data, size_t size) { return std::fwrite(data, 1, size, file) == size; }
+        bool put8(uint8_t value) { return put(&value, 1); }
+        bool put16le(uint16_t value)
+        {
+                uint8_t bytes[2] = {uint8_t(value), uint8_t(value >> 8)};
+                return put(bytes, 2);
+        }
+
+        std::FILE *file{};
+};
+
+class RawEncoder : public FrameEncoder
+{
+public:
+        bool begin(std::FILE *out) override
+        {
+                file = out;
+                return put("C8RV", 4) && put8(RECORD_RAW_VERSION) && put8(VIDEO_WIDTH) && put8(VIDEO_HEIGHT);
+        }
+
+        bool frame(const FrameRows &rows, uint32_t changed, unsigned int repeat) override
+        {
+                uint8_t record[2 + 4 + 8 * VIDEO_HEIGHT];
+                size_t size = 0;
+                record[size++] = repeat;
+                record[size++] = repeat >> 8;
+                for (unsigned int i = 0; i < 4; ++i)
+                {
+                        record[size++] = changed >> (8 * i);
+                }
+                for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+                {
+                        if ((changed >> row) & 1u)
+                        {
+                                for (unsigned int i = 0; i < 8; ++i)
+                                {
+                                        record[size++] = rows[row] >> (8 * i);
+                                }
+                        }
+                }
+                return put(record, size);
+        }
+
+        bool finish() override { return true; }
+};
+
+// Expands rows [first, first + count) to scale x scale pixels, one byte each
+static void expand_rows(const FrameRows &rows, unsigned int first, unsigned int count, unsigned int scale,
+                        std::vector<uint8_t> &pixels)
+{
+        unsigned int width = VIDEO_WIDTH * scale;
+        pixels.resize(size_t(width) * count * scale);
+        uint8_t *out = pixels.data();
+        for (unsigned int row = first; row < first + count; ++row)
+        {
+                uint8_t *line = out;
+                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                {
+                        uint8_t pixel = (rows[row] >> (VIDEO_WIDTH - 1 - x)) & 1u;
+                        std::memset(out, pixel, scale);
+                        out += scale;
+                }
+                for (unsigned int copy = 1; copy < scale; ++copy)
+                {
+                        std::memcpy(out, line, width);
+                        out += width;
+                }
+        }
+}
+
+// Animated GIF with a two-colour global palette. Each image only covers the
+// band of rows that changed and is drawn over the previous one.
+class GifEncoder : public FrameEncoder
+{
+public:
+        explicit GifEncoder(unsigned int scale) : scale(scale) {}
+
+        bool begin(std::FILE *out) override
+        {
+                file = out;
+                static const uint8_t palette[6] = {0x00, 0x00, 0x00, 0xff, 0xff, 0xff};
+                static const uint8_t looping[19] = {0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P',
+                                                    'E',  '2',  '.',  '0', 0x03, 0x01, 0x00, 0x00, 0x00};
+                return put("GIF89a", 6) && put16le(VIDEO_WIDTH * scale) && put16le(VIDEO_HEIGHT * scale) &&
+                       put8(0x80) && put8(0) && put8(0) && put(palette, sizeof(palette)) &&
+                       put(looping, sizeof(looping));
+        }
+
+        bool frame(const FrameRows &rows, uint32_t changed, unsigned int repeat) override
+        {
+                // Delays are in hundredths, rounded so they never drift from 60 Hz
+                shown += repeat;
+                uint64_t end = (shown * 100 + 30) / 60;
+                uint16_t delay = end - delayed;
+                delayed = end;
+
+                unsigned int first, count;
+                changed_span(changed, first, count);
+                expand_rows(rows, first, count, scale, pixels);
+
+                // Graphic control: keep the previous image underneath, no transparency
+                uint8_t control[8] = {0x21, 0xf9, 0x04, 0x04, uint8_t(delay), uint8_t(delay >> 8), 0x00, 0x00};
+                return put(control, sizeof(control)) && put8(0x2c) && put16le(0) && put16le(first * scale) &&
+                       put16le(VIDEO_WIDTH * scale) && put16le(count * scale) && put8(0) && put_lzw();
+        }
+
+        bool finish() override { return put8(0x3b); }
+
+private:
+        static const unsigned int MIN_CODE_SIZE = 2;
+        static const unsigned int CLEAR = 1u << MIN_CODE_SIZE;
+        static const unsigned int END = CLEAR + 1;
+        static const unsigned int MAX_CODES = 4096;
+
+        void put_code(unsigned int code)
+        {
+                bits |= uint32_t(code) << bit_count;
+                bit_count += code_size;
+                while (bit_count >= 8)
+                {
+                        data.push_back(bits & 0xffu);
+                        bits >>= 8;
+                        bit_count -= 8;
+                }
+        }
+
+        void reset_table()
+        {
+                std::memset(children, 0, sizeof(children));
+                next_code = END + 1;
+                code_size = MIN_CODE_SIZE + 1;
+        }
+
+        // LZW over a two-symbol alphabet, so the string table is a binary trie
+        bool put_lzw()
+        {
+                data.clear();
+                bits = 0;
+                bit_count = 0;
+                reset_table();
+                put_code(CLEAR);
+
+                unsigned int prefix = pixels[0];
+                for (size_t i = 1; i < pixels.size(); ++i)
+                {
+                        uint8_t pixel = pixels[i];
+                        if (children[prefix][pixel])
+                        {
+                                prefix = children[prefix][pixel];
+                                continue;
+                        }
+
+                        put_code(prefix);
+                        children[prefix][pixel] = next_code++;
+                        if (next_code > (1u << code_size) && code_size < 12)
+                        {
+                                ++code_size;
+                        }
+                        if (next_code == MAX_CODES)
+                        {
+                                put_code(CLEAR);
+                                reset_table();
+                        }
+                        prefix = pixel;
+                }
+                put_code(prefix);
+
+                // The decoder adds a string for the last code too
+                if (next_code == (1u << code_size) && code_size < 12)
+                {
+                        ++code_size;
+                }
+                put_code(END);
+                if (bit_count > 0)
+                {
+                        data.push_back(bits & 0xffu);
+                }
+
+                if (!put8(MIN_CODE_SIZE))
+                {
+                        return false;
+                }
+                for (size_t offset = 0; offset < data.size(); offset += 255)
+                {
+                        size_t length = std::min<size_t>(255, data.size() - offset);
+                        if (!put8(length) || !put(&data[offset], length))
+                        {
+                                return false;
+                        }
+                }
+                return put8(0);
+        }
+
+        unsigned int scale;
+        uint64_t shown{};
+        uint64_t delayed{};
+        std::vector<uint8_t> pixels;
+        std::vector<uint8_t> data;
+
+        uint16_t children[MAX_CODES][2];
+        unsigned int next_code{};
+        unsigned int code_size{};
+        uint32_t bits{};
+        unsigned int bit_count{};
+};
+
+// APNG with a 1-bit palette image. Frames after the first cover the band
+// of changed rows and replace those pixels in place.
+class ApngEncoder : public FrameEncoder
+{
+public:
+        explicit ApngEncoder(unsigned int scale) : scale(scale) {}
+
+        bool begin(std::FILE *out) override
+        {
+                file = out;
+                static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+                static const uint8_t palette[6] = {0x00, 0x00, 0x00, 0xff, 0xff, 0xff};
+
+                uint8_t header[13] = {};
+                store32(header, VIDEO_WIDTH * scale);
+                store32(header + 4, VIDEO_HEIGHT * scale);
+                header[8] = 1;     // bit depth
+                header[9] = 3;     // palette colour
+
+                // Frame count is patched in by finish()
+                uint8_t control[8] = {};
+                if (!put(signature, sizeof(signature)) || !put_chunk("IHDR", header, sizeof(header)))
+                {
+                        return false;
+                }
+                control_offset = std::ftell(file);
+                return put_chunk("acTL", control, sizeof(control)) && put_chunk("PLTE", palette, sizeof(palette));
+        }
+
+        bool frame(const FrameRows &rows, uint32_t changed, unsigned int repeat) override
+        {
+                unsigned int first, count;
+                changed_span(changed, first, count);
+
+                // Rows of packed pixels behind a "none" filter byte
+                unsigned int width = VIDEO_WIDTH * scale;
+                unsigned int stride = 1 + width / 8;
+                std::vector<uint8_t> pixels;
+                expand_rows(rows, first, count, scale, pixels);
+                raw.assign(size_t(stride) * count * scale, 0);
+                for (unsigned int line = 0; line < count * scale; ++line)
+                {
+                        uint8_t *out = &raw[size_t(line) * stride + 1];
+                        const uint8_t *in = &pixels[size_t(line) * width];
+                        for (unsigned int x = 0; x < width; ++x)
+                        {
+                                out[x / 8] |= in[x] << (7 - x % 8);
+                        }
+                }
+
+                uLongf packed_size = compressBound(raw.size());
+                packed.resize(4 + packed_size);
+                if (compress2(packed.data() + 4, &packed_size, raw.data(), raw.size(), Z_BEST_COMPRESSION) != Z_OK)
+                {
+                        return false;
+                }
+
+                uint8_t control[26] = {};
+                store32(control, sequence++);
+                store32(control + 4, width);
+                store32(control + 8, count * scale);
+                store32(control + 12, 0);
+                store32(control + 16, first * scale);
+                control[20] = repeat >> 8;
+                control[21] = repeat;
+                control[23] = 60;  // delay is repeat / 60 s; dispose none, blend source
+                if (!put_chunk("fcTL", control, sizeof(control)))
+                {
+                        return false;
+                }
+
+                ++frame_count;
+                if (frame_count == 1)
+                {
+                        return put_chunk("IDAT", packed.data() + 4, packed_size);
+                }
+                store32(packed.data(), sequence++);
+                return put_chunk("fdAT", packed.data(), packed_size + 4);
+        }
+
+        bool finish() override
+        {
+                if (!put_chunk("IEND", nullptr, 0))
+                {
+                        return false;
+                }
+                uint8_t control[8] = {};
+                store32(control, frame_count);
+                return std::fseek(file, control_offset, SEEK_SET) == 0 && put_chunk("acTL", control, sizeof(control)) &&
+                       std::fseek(file, 0, SEEK_END) == 0;
+        }
+
+private:
+        static void store32(uint8_t *out, uint32_t value)
+        {
+                out[0] = value >> 24;
+                out[1] = value >> 16;
+                out[2] = value >> 8;
+                out[3] = value;
+        }
+
+        bool put_chunk(const char *type, const uint8_t *payload, size_t size)
+        {
+                uint8_t length[4];
+                store32(length, size);
+                uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+                if (size > 0)
+                {
+                        crc = crc32(crc, payload, size);
+                }
+                uint8_t check[4];
+                store32(check, crc);
+                return put(length, 4) && put(type, 4) && (size == 0 || put(payload, size)) && put(check, 4);
+        }
+
+        unsigned int scale;
+        long control_offset{};
+        uint32_t sequence{};
+        uint32_t frame_count{};
+        std::vector<uint8_t> raw;
+        std::vector<uint8_t> packed;
+};
+
+Recorder::Recorder() = default;
+
+Recorder::~Recorder()
+{
+        close();
+}
+
+bool Recorder::open(std::string filename, RecordFormat format, unsigned int scale)
+{
+        if (file)
+        {
+                return false;
+        }
+
+        file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+        {
+                return false;
+        }
+
+        scale = std::max(1u, scale);
+        switch (format)
+        {
+        case RecordFormat::RAW:
+                encoder = std::make_unique<RawEncoder>();
+                break;
+        case RecordFormat::GIF:
+                encoder = std::make_unique<GifEncoder>(scale);
+                break;
+        case RecordFormat::APNG:
+                encoder = std::make_unique<ApngEncoder>(scale);
+                break;
+        }
+
+        if (!encoder->begin(file))
+        {
+                std::fclose(file);
+                file = nullptr;
+                encoder.reset();
+                return false;
+        }
+
+        queue = std::make_unique<FrameRows[]>(QUEUE_FRAMES);
+        head.store(0);
+        tail.store(0);
+        closing.store(false);
+        pushed = 0;
+        dropped_count = 0;
+        worker = std::thread(&Recorder::encode_loop, this);
+        return true;
+}
+
+void Recorder::push(void const *buffer, int pitch)
+{
+        if (!file)
+        {
+                return;
+        }
+
+        ++pushed;
+        uint64_t position = head.load(std::memory_order_relaxed);
+        uint64_t taken = tail.load(std::memory_order_acquire);
+        while (lossless && position - taken == QUEUE_FRAMES)
+        {
+                tail.wait(taken, std::memory_order_acquire);
+                taken = tail.load(std::memory_order_acquire);
+        }
+        if (position - taken == QUEUE_FRAMES)
+        {
+                ++dropped_count;
+                return;
+        }
+
+        FrameRows &rows = queue[position % QUEUE_FRAMES];
+        for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+        {
+                auto pixels = reinterpret_cast<const uint32_t *>(static_cast<const uint8_t *>(buffer) + row * pitch);
+                uint64_t bits = 0;
+                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                {
+                        bits = (bits << 1) | (pixels[x] ? 1u : 0u);
+                }
+                rows[row] = bits;
+        }
+        head.store(position + 1, std::memory_order_release);
+
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+}
+
+void Recorder::encode_loop()
+{
+        // The image on screen and how long it has been there, written out
+        // once a different one arrives
+        FrameRows pending{};
+        uint32_t pending_changed = ALL_ROWS;
+        unsigned int repeat = 0;
+        bool ok = true;
+
+        while (true)
+        {
+                uint32_t seen = signal.load(std::memory_order_acquire);
+                uint64_t position = tail.load(std::memory_order_relaxed);
+                uint64_t end = head.load(std::memory_order_acquire);
+
+                for (; position < end; ++position)
+                {
+                        const FrameRows &rows = queue[position % QUEUE_FRAMES];
+                        uint32_t changed = 0;
+                        for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+                        {
+                                changed |= uint32_t(rows[row] != pending[row]) << row;
+                        }
+
+                        if (repeat == 0)
+                        {
+                                pending = rows;
+                                repeat = 1;
+                        }
+                        else if (changed == 0 && repeat < MAX_REPEAT)
+                        {
+                                ++repeat;
+                        }
+                        else
+                        {
+                                ok = encoder->frame(pending, pending_changed, repeat) && ok;
+                                pending = rows;
+                                pending_changed = changed;
+                                repeat = 1;
+                        }
+                        tail.store(position + 1, std::memory_order_release);
+                        tail.notify_one();
+                }
+
+                if (closing.load(std::memory_order_acquire) && tail.load() == head.load(std::memory_order_acquire))
+                {
+                        break;
+                }
+                signal.wait(seen, std::memory_order_acquire);
+        }
+
+        if (repeat > 0)
+        {
+                ok = encoder->frame(pending, pending_changed, repeat) && ok;
+        }
+        failed = !(encoder->finish() && ok);
+}
+
+bool Recorder::close()
+{
+        if (!file)
+        {
+                return true;
+        }
+
+        closing.store(true, std::memory_order_release);
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+        worker.join();
+
+        bool ok = !failed && std::fclose(file) == 0;
+        file = nullptr;
+        encoder.reset();
+        queue.reset();
+        return ok;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+// RAW is a delta stream, all integers little-endian:
+//
+//   "C8RV" version:u8 width:u8 height:u8
+//   then one record per distinct image:
+//   repeat:u16 changed:u32 rows[popcount(changed)]:u64
+//
+// repeat counts the 60 Hz frames the image stays on screen, bit y of
+// changed marks row y as differing from the previous image, and a row holds
+// one bit per pixel with x = 0 in bit 63.
+enum class RecordFormat { RAW, GIF, APNG };
+
+const uint8_t RECORD_RAW_VERSION = 1;
+
+// .gif and .png/.apng by extension, anything else RAW
+RecordFormat record_format_for(std::string filename);
+
+using FrameRows = std::array<uint64_t, VIDEO_HEIGHT>;
+
+class FrameEncoder;
+
+// Records 60 Hz frames into a file. push() only packs the frame to one bit
+// per pixel and queues it; a background thread compares it against the
+// previous frame and encodes changed rows, so a frame identical to the last
+// one costs a counter increment. If the encoder falls behind by more than
+// the queue holds, frames are dropped rather than stalling the caller.
+class Recorder
+{
+public:
+        Recorder();
+        ~Recorder();
+
+        Recorder(const Recorder &) = delete;
+        Recorder &operator=(const Recorder &) = delete;
+
+        // scale enlarges pixels in GIF and APNG output
+        bool open(std::string filename, RecordFormat format, unsigned int scale = 4);
+
+        // Same arguments as Platform::Update; call once per 60 Hz frame
+        void push(void const *buffer, int pitch);
+
+        // Encodes what is queued and finishes the file. Returns false if
+        // anything failed to write.
+        bool close();
+
+        uint64_t frames() const { return pushed; }
+        uint64_t dropped() const { return dropped_count; }
+
+        // For offline runs: push() waits for room instead of dropping
+        bool lossless{false};
+
+private:
+        static const unsigned int QUEUE_FRAMES = 1024;
+
+        void encode_loop();
+
+        std::FILE *file{nullptr};
+        std::unique_ptr<FrameEncoder> encoder;
+        std::thread worker;
+
+        // Single producer, single consumer ring of packed frames
+        std::unique_ptr<FrameRows[]> queue;
+        std::atomic<uint64_t> head{0};     // frames queued by push()
+        std::atomic<uint64_t> tail{0};     // frames taken by the encoder
+        std::atomic<uint32_t> signal{0};   // bumped to wake the encoder
+        std::atomic<bool> closing{false};
+        bool failed{};                     // set by the encoder thread before it exits
+
+        uint64_t pushed{};
+        uint64_t dropped_count{};
+};
@@ -0,0 +1,295 @@
+#include "reference.h"
+
+#include <algorithm>
+
+const unsigned int REFERENCE_FONT_ADDRESS = 0x50;
+
+static const uint8_t REFERENCE_FONT[80] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+void ReferenceChip8::reset(const uint8_t *rom, size_t size, uint16_t keys, uint32_t seed)
+{
+        v_registers.fill(0);
+        memory.fill(0);
+        stack.fill(0);
+        display.fill(0);
+        pc = START_ADDRESS;
+        index = 0;
+        sound_timer = 0;
+        delay_timer = 0;
+        sp = 0;
+        keypad = keys;
+        findings.fill(0);
+        first_finding_pc = 0;
+
+        std::copy(REFERENCE_FONT, REFERENCE_FONT + sizeof(REFERENCE_FONT), memory.begin() + REFERENCE_FONT_ADDRESS);
+        std::copy(rom, rom + std::min<size_t>(size, MEMORY_SIZE - START_ADDRESS), memory.begin() + START_ADDRESS);
+
+        rand_gen.seed(seed);
+        rand_byte.reset();
+}
+
+void ReferenceChip8::found(BoundsFinding finding)
+{
+        if (std::all_of(findings.begin(), findings.end(), [](uint32_t count) { return count == 0; }))
+        {
+                first_finding_pc = instruction_pc;
+        }
+        ++findings[finding];
+}
+
+uint8_t &ReferenceChip8::memory_at(unsigned int address)
+{
+        if (address >= MEMORY_SIZE)
+        {
+                found(FINDING_MEMORY);
+        }
+        return memory[address % MEMORY_SIZE];
+}
+
+uint16_t &ReferenceChip8::stack_at(unsigned int level)
+{
+        if (level >= STACK_LEVELS)
+        {
+                found(FINDING_STACK);
+        }
+        return stack[level % STACK_LEVELS];
+}
+
+void ReferenceChip8::tick_timers()
+{
+        if (delay_timer > 0)
+        {
+                --delay_timer;
+        }
+        if (sound_timer > 0)
+        {
+                --sound_timer;
+        }
+}
+
+void ReferenceChip8::step()
+{
+        instruction_pc = pc;
+        if (pc >= MEMORY_SIZE)
+        {
+                found(FINDING_PC);
+        }
+        uint16_t opcode = (memory_at(pc % MEMORY_SIZE) << 8u) | memory_at(pc % MEMORY_SIZE + 1);
+        pc += 2;
+
+        unsigned int x = (opcode >> 8) & 0xf;
+        unsigned int y = (opcode >> 4) & 0xf;
+        unsigned int n = opcode & 0xf;
+        uint8_t kk = opcode & 0xff;
+        uint16_t nnn = opcode & 0xfff;
+        uint8_t &vx = v_registers[x];
+        uint8_t &vy = v_registers[y];
+        uint8_t &vf = v_registers[0xf];
+
+        switch (opcode >> 12)
+        {
+        case 0x0:
+                // 0nnn (SYS) and everything else in the group does nothing
+                if (opcode == 0x00e0)
+                {
+                        display.fill(0);
+                }
+                else if (opcode == 0x00ee)
+                {
+                        --sp;
+                        pc = stack_at(sp);
+                }
+                break;
+        case 0x1:
+                pc = nnn;
+                break;
+        case 0x2:
+                stack_at(sp) = pc;
+                ++sp;
+                pc = nnn;
+                break;
+        case 0x3:
+                pc += (vx == kk) ? 2 : 0;
+                break;
+        case 0x4:
+                pc += (vx != kk) ? 2 : 0;
+                break;
+        case 0x5:
+                pc += (n == 0 && vx == vy) ? 2 : 0;
+                break;
+        case 0x6:
+                vx = kk;
+                break;
+        case 0x7:
+                vx += kk;
+                break;
+        case 0x8:
+                // VF is written before Vx, so Vx wins when x is F
+                switch (n)
+                {
+                case 0x0:
+                        vx = vy;
+                        break;
+                case 0x1:
+                        vx |= vy;
+                        break;
+                case 0x2:
+                        vx &= vy;
+                        break;
+                case 0x3:
+                        vx ^= vy;
+                        break;
+                case 0x4:
+                {
+                        unsigned int sum = vx + vy;
+                        vf = sum > 255u;
+                        vx = sum;
+                        break;
+                }
+                case 0x5:
+                        vf = vx > vy;
+                        vx -= vy;
+                        break;
+                case 0x6:
+                        vf = vx & 1u;
+                        vx >>= 1;
+                        break;
+                case 0x7:
+                        vf = vy > vx;
+                        vx = vy - vx;
+                        break;
+                case 0xe:
+                        vf = vx >> 7;
+                        vx <<= 1;
+                        break;
+                }
+                break;
+        case 0x9:
+                pc += (n == 0 && vx != vy) ? 2 : 0;
+                break;
+        case 0xa:
+                index = nnn;
+                break;
+        case 0xb:
+                pc = v_registers[0] + nnn;
+                break;
+        case 0xc:
+                vx = rand_byte(rand_gen) & kk;
+                break;
+        case 0xd:
+        {
+                unsigned int left = vx % VIDEO_WIDTH;
+                unsigned int top = vy % VIDEO_HEIGHT;
+                vf = 0;
+                for (unsigned int row = 0; row < n && top + row < VIDEO_HEIGHT; ++row)
+                {
+                        uint8_t sprite = memory_at(index + row);
+                        for (unsigned int col = 0; col < 8 && left + col < VIDEO_WIDTH; ++col)
+                        {
+                                if (sprite & (0x80u >> col))
+                                {
+                                        uint32_t &pixel = display[(top + row) * VIDEO_WIDTH + left + col];
+                                        if (pixel)
+                                        {
+                                                vf = 1;
+                                        }
+                                        pixel ^= 0xffffffffu;
+                                }
+                        }
+                }
+                break;
+        }
+        case 0xe:
+                if (kk == 0x9e)
+                {
+                        pc += (keypad & (1u << (vx & 0xf))) ? 2 : 0;
+                }
+                else if (kk == 0xa1)
+                {
+                        pc += (keypad & (1u << (vx & 0xf))) ? 0 : 2;
+                }
+                break;
+        case 0xf:
+                switch (kk)
+                {
+                case 0x07:
+                        vx = delay_timer;
+                        break;
+                case 0x0a:
+                        if (keypad)
+                        {
+                                vx = __builtin_ctz(keypad);
+                        }
+                        else
+                        {
+                                pc -= 2;
+                        }
+                        break;
+                case 0x15:
+                        delay_timer = vx;
+                        break;
+                case 0x18:
+                        sound_timer = vx;
+                        break;
+                case 0x1e:
+                        index += vx;
+                        break;
+                case 0x29:
+                        index = REFERENCE_FONT_ADDRESS + 5 * vx;
+                        break;
+                case 0x33:
+                {
+                        uint8_t value = vx;
+                        memory_at(index + 2) = value % 10;
+                        memory_at(index + 1) = value / 10 % 10;
+                        memory_at(index) = value / 100;
+                        break;
+                }
+                case 0x55:
+                        for (unsigned int i = 0; i <= x; ++i)
+                        {
+                                memory_at(index + i) = v_registers[i];
+                        }
+                        break;
+                case 0x65:
+                        for (unsigned int i = 0; i <= x; ++i)
+                        {
+                                v_registers[i] = memory_at(index + i);
+                        }
+                        break;
+                }
+                break;
+        }
+
+#ifndef CHIP8_VIP_TIMING
+        tick_timers();
+#endif
+}
+
+void ReferenceChip8::run_frame(unsigned int instructions_per_frame)
+{
+        for (unsigned int i = 0; i < instructions_per_frame; ++i)
+        {
+                step();
+        }
+#ifdef CHIP8_VIP_TIMING
+        tick_timers();
+#endif
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <random>
+
+// Ways a program can reach outside the machine. Chip8 wraps all of them;
+// the reference wraps the same way after recording the access.
+enum BoundsFinding
+{
+        FINDING_MEMORY,    // memory[index + i] or a fetch past the last byte
+        FINDING_STACK,     // a call with sp >= STACK_LEVELS, or a return with sp out of range
+        FINDING_PC,        // pc at or past MEMORY_SIZE when fetching
+        FINDING_COUNT
+};
+
+// Plain interpreter the fuzzer checks the real engines against. It decodes
+// with its own nibble switch and checks every memory, stack and pc access,
+// so it is slow but easy to audit. Semantics match Chip8, quirks included;
+// change both together.
+class ReferenceChip8
+{
+public:
+        // Power-on state with rom at START_ADDRESS and the RNG seeded like Chip8::seed
+        void reset(const uint8_t *rom, size_t size, uint16_t keys, uint32_t seed);
+
+        void step();
+        // One frame of instructions_per_frame steps; timers tick as in Chip8
+        void run_frame(unsigned int instructions_per_frame);
+
+        std::array<uint8_t, REGISTER_COUNT> v_registers{};
+        std::array<uint8_t, MEMORY_SIZE> memory{};
+        std::array<uint16_t, STACK_LEVELS> stack{};
+        std::array<uint32_t, VIDEO_WIDTH * VIDEO_HEIGHT> display{};
+        uint16_t pc{};
+        uint16_t index{};
+        uint8_t sound_timer{};
+        uint8_t delay_timer{};
+        uint8_t sp{};
+        uint16_t keypad{};
+
+        // Accesses out of bounds since reset, and where the first one was
+        std::array<uint32_t, FINDING_COUNT> findings{};
+        uint16_t first_finding_pc{};
+
+private:
+        uint8_t &memory_at(unsigned int address);
+        uint16_t &stack_at(unsigned int level);
+        void found(BoundsFinding finding);
+        void tick_timers();
+
+        uint16_t instruction_pc{};
+        std::default_random_engine rand_gen;
+        std::uniform_int_distribution<uint8_t> rand_byte{0, 255u};
+};
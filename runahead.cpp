@@ -0,0 +1,78 @@
+#include "runahead.h"
+#include "key_events.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// MetricsExporter may be reading counters, so store them the way count() does
+static void put_back(InstanceCounters &counters, const InstanceCounters &saved)
+{
+        for (auto field : {&InstanceCounters::instructions, &InstanceCounters::frames, &InstanceCounters::draws,
+                           &InstanceCounters::collisions, &InstanceCounters::idle_frames})
+        {
+                std::atomic_ref<uint64_t>(counters.*field).store(saved.*field, std::memory_order_relaxed);
+        }
+}
+
+void RunAhead::speculate(Chip8 &chip8)
+{
+        started_ns = input_clock_ns();
+        chip8.save(snapshot);
+        uint64_t saved_ns = input_clock_ns();
+
+        // Speculative frames see the held keys but must not drain queued
+        // events, record latency or coverage, report stores or count as
+        // real frames. restore() leaves counters alone, so they are kept here.
+        input = chip8.input;
+        store_watch = chip8.store_watch;
+        coverage = chip8.coverage;
+        counters = chip8.counters;
+        flush_metrics = chip8.flush_metrics;
+        chip8.input = nullptr;
+        chip8.store_watch = nullptr;
+        chip8.coverage = nullptr;
+        chip8.flush_metrics = false;
+
+        for (unsigned int i = 0; i < ahead; ++i)
+        {
+                chip8.run_frame();
+        }
+        metric_add(METRIC_SPECULATIVE_FRAMES, ahead);
+
+        speculated_ns = input_clock_ns();
+        totals.save_ns += saved_ns - started_ns;
+        totals.run_ns += speculated_ns - saved_ns;
+}
+
+void RunAhead::rollback(Chip8 &chip8)
+{
+        uint64_t rollback_ns = input_clock_ns();
+        chip8.restore(snapshot);
+        chip8.input = input;
+        chip8.store_watch = store_watch;
+        chip8.coverage = coverage;
+        put_back(chip8.counters, counters);
+        chip8.flush_metrics = flush_metrics;
+
+        uint64_t now = input_clock_ns();
+        totals.restore_ns += now - rollback_ns;
+        // Time spent presenting between the two calls is not emulation
+        totals.max_ns = std::max(totals.max_ns, now - rollback_ns + speculated_ns - started_ns);
+        ++totals.count;
+}
+
+std::string RunAhead::report() const
+{
+        double count = totals.count ? totals.count : 1;
+        char text[256];
+        std::snprintf(text, sizeof(text),
+                      "run-ahead of %u frames over %llu host frames (avg us):\n"
+                      "  save    %10.2f\n"
+                      "  run     %10.2f\n"
+                      "  restore %10.2f\n"
+                      "  total   %10.2f (max %.2f)\n",
+                      ahead, (unsigned long long)totals.count, totals.save_ns / 1000.0 / count,
+                      totals.run_ns / 1000.0 / count, totals.restore_ns / 1000.0 / count, totals.average_us(),
+                      totals.max_ns / 1000.0);
+        return text;
+}
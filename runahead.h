@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <string>
+
+// Past this a frame shows more than 130 ms early and costs nine frames of
+// emulation per host frame
+const unsigned int RUNAHEAD_MAX_FRAMES = 8;
+
+// Hides a game's own input lag by showing a frame from the future. After
+// each real frame, speculate() saves the machine in place and runs frames()
+// more with the keys currently held; the caller presents chip8.display and
+// then calls rollback(), which restores the real state. Costs 1 + frames()
+// frames of emulation per host frame plus a save and a restore, most of
+// which copy only what the speculative frames wrote. Speculative frames stay
+// out of counters and the process metrics; METRIC_SPECULATIVE_FRAMES counts
+// them instead.
+class RunAhead
+{
+public:
+        explicit RunAhead(unsigned int frames) : ahead(frames) {}
+
+        unsigned int frames() const { return ahead; }
+
+        void speculate(Chip8 &chip8);
+        void rollback(Chip8 &chip8);
+
+        // Host time per speculate/rollback pair, for picking frames() per ROM
+        struct Cost
+        {
+                uint64_t count{};
+                uint64_t save_ns{};
+                uint64_t run_ns{};
+                uint64_t restore_ns{};
+                uint64_t max_ns{};
+
+                double average_us() const { return count ? (save_ns + run_ns + restore_ns) / 1000.0 / count : 0; }
+        };
+
+        const Cost &cost() const { return totals; }
+        std::string report() const;
+
+private:
+        unsigned int ahead;
+        Chip8Snapshot snapshot;
+        InstanceCounters counters;
+        bool flush_metrics{};
+        KeyEventQueue *input{nullptr};
+        StoreWatch *store_watch{nullptr};
+        Coverage *coverage{nullptr};
+        uint64_t started_ns{};
+        uint64_t speculated_ns{};
+        Cost totals;
+};
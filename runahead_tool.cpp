@@ -0,0 +1,72 @@
+#include "input_script.h"
+#include "runahead.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Runs a ROM headless with every run-ahead depth up to MaxAhead, printing
+// what each costs per host frame and checking that rollback is exact
+int main(int argc, char ** argv)
+{
+	if (argc < 3 || argc > 5) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Frames> [MaxAhead] [Input]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	unsigned int frames = std::stoi(argv[2]);
+	unsigned int max_ahead = (argc >= 4) ? std::stoi(argv[3]) : 4;
+
+	std::vector<uint64_t> baseline;
+	for (unsigned int ahead = 0; ahead <= max_ahead; ++ahead) {
+		InputScript input;
+		if (argc == 5 && !input.load(argv[4])) {
+			std::cerr << "Could not read " << argv[4] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		Chip8 chip8;
+		chip8.seed(1);
+		chip8.load_rom(argv[1]);
+		RunAhead runahead(ahead);
+
+		std::vector<uint64_t> real;
+		std::vector<uint64_t> shown;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int frame = 0; frame < frames; ++frame) {
+			input.apply(frame, chip8);
+			chip8.run_frame();
+			real.push_back(chip8.hash_frame());
+			if (ahead > 0) {
+				runahead.speculate(chip8);
+				shown.push_back(chip8.hash_frame());
+				runahead.rollback(chip8);
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (ahead == 0) {
+			baseline = real;
+			std::cout << "no run-ahead: " << seconds * 1e6 / frames << " us/frame\n";
+			continue;
+		}
+
+		// Without scripted input the frame shown at t is the real frame t + ahead
+		unsigned int early = 0;
+		for (unsigned int frame = 0; frame + ahead < frames; ++frame) {
+			early += (shown[frame] == real[frame + ahead]);
+		}
+
+		const RunAhead::Cost &cost = runahead.cost();
+		std::cout << "ahead " << ahead << ": " << seconds * 1e6 / frames << " us/frame, speculation "
+		          << cost.average_us() << " us (save " << cost.save_ns / 1000.0 / cost.count
+		          << ", run " << cost.run_ns / 1000.0 / cost.count
+		          << ", restore " << cost.restore_ns / 1000.0 / cost.count
+		          << ", max " << cost.max_ns / 1000.0 << "), "
+		          << (real == baseline ? "rollback exact" : "ROLLBACK DIVERGED") << ", "
+		          << early << "/" << (frames > ahead ? frames - ahead : 0) << " frames shown early\n";
+		if (real != baseline) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	return 0;
+}
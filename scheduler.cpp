@@ -0,0 +1,402 @@
+#include "scheduler.h"
+#include <pthread.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+struct NumaNode
+{
+        int id;
+        cpu_set_t cpus;            // ones this process may run on
+};
+
+// Expands a sysfs list such as "0-3,8-11"
+static std::vector<unsigned int> parse_list(const std::string &text)
+{
+        std::vector<unsigned int> values;
+        size_t position = 0;
+        while (position < text.size())
+        {
+                size_t end = text.find(',', position);
+                std::string range = text.substr(position, end - position);
+                unsigned int first = 0, last = 0;
+                int fields = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+                if (fields >= 1)
+                {
+                        for (unsigned int value = first; value <= ((fields == 2) ? last : first); ++value)
+                        {
+                                values.push_back(value);
+                        }
+                }
+                if (end == std::string::npos)
+                {
+                        break;
+                }
+                position = end + 1;
+        }
+        return values;
+}
+
+static std::string read_line(const std::string &path)
+{
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+}
+
+// Online nodes with CPUs this process may use, empty if unknown
+static std::vector<NumaNode> numa_nodes()
+{
+        std::vector<NumaNode> nodes;
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+                return nodes;
+        }
+        for (unsigned int id : parse_list(read_line("/sys/devices/system/node/online")))
+        {
+                NumaNode node{int(id), {}};
+                CPU_ZERO(&node.cpus);
+                for (unsigned int cpu :
+                     parse_list(read_line("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist")))
+                {
+                        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                        {
+                                CPU_SET(cpu, &node.cpus);
+                        }
+                }
+                if (CPU_COUNT(&node.cpus) > 0)
+                {
+                        nodes.push_back(node);
+                }
+        }
+        return nodes;
+}
+
+// Suspends until the next frame: straight back on the run queue, or onto the
+// sleeping list until the ticker releases it when frames are paced
+struct Scheduler::NextFrame
+{
+        Scheduler &scheduler;
+        Instance &instance;
+
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> task)
+        {
+                if (scheduler.frame_interval.count() == 0)
+                {
+                        scheduler.enqueue(task, instance.home);
+                        return;
+                }
+                std::lock_guard<std::mutex> guard(scheduler.sleeping_lock);
+                scheduler.sleeping.push_back(&instance);
+        }
+        void await_resume() noexcept {}
+};
+
+// Parks the instance until set_keys() reports a key
+struct Scheduler::KeyWait
+{
+        Scheduler &scheduler;
+        Instance &instance;
+
+        bool await_ready() noexcept { return instance.keys.load(std::memory_order_acquire) != 0; }
+        void await_suspend(std::coroutine_handle<> task)
+        {
+                // Once PARKED is visible set_keys may resume the task on another
+                // thread, which destroys this awaiter; touch only these after it
+                Scheduler &owner = scheduler;
+                std::atomic<int> &state = instance.state;
+                std::atomic<uint16_t> &keys = instance.keys;
+                unsigned int home = instance.home;
+
+                owner.parked_count.fetch_add(1, std::memory_order_relaxed);
+                state.store(Instance::PARKED, std::memory_order_seq_cst);
+
+                // A key may have arrived before the instance was marked parked.
+                // Whoever moves it out of PARKED queues it, so each park is
+                // resumed exactly once and never inline on this thread.
+                int parked = Instance::PARKED;
+                if (keys.load(std::memory_order_seq_cst) != 0 &&
+                    state.compare_exchange_strong(parked, Instance::RUNNABLE))
+                {
+                        owner.parked_count.fetch_sub(1, std::memory_order_relaxed);
+                        owner.enqueue(task, home);
+                }
+        }
+        void await_resume() noexcept {}
+};
+
+Scheduler::Scheduler(unsigned int workers, std::chrono::microseconds frame_interval, bool pooled)
+    : frame_interval(frame_interval)
+{
+        // Workers are dealt round the nodes. With a single node there is
+        // nothing to keep local, so leave placement to the kernel.
+        std::vector<NumaNode> nodes = numa_nodes();
+        for (unsigned int i = 0; i < std::max(1u, workers); ++i)
+        {
+                queues.push_back(std::make_unique<WorkerQueue>());
+                int node = -1;
+                if (nodes.size() > 1)
+                {
+                        const NumaNode &home = nodes[i % nodes.size()];
+                        node = home.id;
+                        queues.back()->pinned = true;
+                        queues.back()->cpus = home.cpus;
+                }
+                if (pooled)
+                {
+                        // Binding to the node matters because spawn() touches
+                        // the slabs first, from the caller's thread
+                        pools.push_back(std::make_unique<InstancePool>(node));
+                }
+        }
+}
+
+Scheduler::~Scheduler()
+{
+        // Tasks that never finished still own their coroutine frames
+        for (auto &queue : queues)
+        {
+                for (auto task : queue->tasks)
+                {
+                        task.destroy();
+                }
+        }
+        for (Instance *instance : sleeping)
+        {
+                instance->handle.destroy();
+        }
+        for (auto &instance : all)
+        {
+                if (instance->state.load() == Instance::PARKED)
+                {
+                        instance->handle.destroy();
+                }
+        }
+}
+
+Task Scheduler::instance_task(Instance &instance, uint64_t frames)
+{
+        for (uint64_t frame = 0; frame < frames && !stopping.load(std::memory_order_relaxed); ++frame)
+        {
+                instance.chip8.keypad = instance.keys.load(std::memory_order_acquire);
+
+                instance.chip8.run_frame();
+                ++instance.frames;
+                if (on_frame)
+                {
+                        on_frame(instance);
+                }
+
+                // Nothing to wait for after the last frame, not even a key
+                if (frame + 1 == frames)
+                {
+                        break;
+                }
+                if (instance.chip8.waiting_for_key())
+                {
+                        co_await KeyWait{*this, instance};
+                }
+                else
+                {
+                        co_await NextFrame{*this, instance};
+                }
+        }
+}
+
+Instance &Scheduler::spawn(const Chip8 &initial, uint64_t frames)
+{
+        unsigned int home = all.size() % queues.size();
+        Chip8 *chip8;
+        if (pools.empty())
+        {
+                unpooled.push_back(std::make_unique<Chip8>(initial));
+                chip8 = unpooled.back().get();
+        }
+        else
+        {
+                chip8 = pools[home]->acquire(initial);
+        }
+
+        all.push_back(std::make_unique<Instance>(*chip8, home));
+        Instance &instance = *all.back();
+        instance.id = all.size() - 1;
+
+        Task task = instance_task(instance, frames);
+        task.handle.promise().scheduler = this;
+        instance.handle = task.handle;
+
+        live.fetch_add(1);
+        enqueue(task.handle, home);
+        return instance;
+}
+
+void Scheduler::set_keys(Instance &instance, uint16_t keys)
+{
+        instance.keys.store(keys, std::memory_order_seq_cst);
+
+        int parked = Instance::PARKED;
+        if (keys != 0 && instance.state.load(std::memory_order_seq_cst) == Instance::PARKED &&
+            instance.state.compare_exchange_strong(parked, Instance::RUNNABLE))
+        {
+                parked_count.fetch_sub(1, std::memory_order_relaxed);
+                enqueue(instance.handle, instance.home);
+        }
+}
+
+std::vector<PoolStats> Scheduler::pool_stats() const
+{
+        std::vector<PoolStats> stats;
+        for (auto &pool : pools)
+        {
+                stats.push_back(pool->stats());
+        }
+        return stats;
+}
+
+void Scheduler::enqueue(std::coroutine_handle<> task, unsigned int worker)
+{
+        {
+                std::lock_guard<std::mutex> guard(queues[worker]->lock);
+                queues[worker]->tasks.push_back(task);
+        }
+        queued.fetch_add(1, std::memory_order_release);
+
+        // Taking the lock orders this wakeup after a sleeping worker's check
+        {
+                std::lock_guard<std::mutex> guard(idle_lock);
+        }
+        idle.notify_one();
+}
+
+bool Scheduler::dequeue(unsigned int worker, std::coroutine_handle<> &task)
+{
+        // Own queue from the front, then steal from the back of the others
+        for (unsigned int i = 0; i < queues.size(); ++i)
+        {
+                WorkerQueue &queue = *queues[(worker + i) % queues.size()];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if (queue.tasks.empty())
+                {
+                        continue;
+                }
+                if (i == 0)
+                {
+                        task = queue.tasks.front();
+                        queue.tasks.pop_front();
+                }
+                else
+                {
+                        task = queue.tasks.back();
+                        queue.tasks.pop_back();
+                }
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+        }
+        return false;
+}
+
+void Scheduler::worker_loop(unsigned int worker)
+{
+        // Worker 0 borrows the caller's thread, so give its affinity back after
+        WorkerQueue &own = *queues[worker];
+        cpu_set_t previous;
+        bool pinned = own.pinned && pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0 &&
+                      pthread_setaffinity_np(pthread_self(), sizeof(own.cpus), &own.cpus) == 0;
+        std::coroutine_handle<> task;
+
+        while (true)
+        {
+                if (dequeue(worker, task))
+                {
+                        task.resume();
+                        continue;
+                }
+
+                std::unique_lock<std::mutex> guard(idle_lock);
+                idle.wait(guard, [this]() {
+                        return queued.load(std::memory_order_acquire) > 0 || live.load() == 0 || stopping.load();
+                });
+                if (live.load() == 0 || stopping.load())
+                {
+                        break;
+                }
+        }
+
+        if (pinned)
+        {
+                pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+        }
+}
+
+void Scheduler::ticker_loop()
+{
+        auto next_tick = std::chrono::steady_clock::now() + frame_interval;
+        std::vector<Instance *> waking;
+
+        while (live.load() > 0 && !stopping.load())
+        {
+                std::this_thread::sleep_until(next_tick);
+                uint64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - next_tick).count();
+                metric_tick(lag);
+                next_tick += frame_interval;
+
+                {
+                        std::lock_guard<std::mutex> guard(sleeping_lock);
+                        waking.swap(sleeping);
+                }
+                for (Instance *instance : waking)
+                {
+                        enqueue(instance->handle, instance->home);
+                }
+                waking.clear();
+        }
+}
+
+void Scheduler::task_finished()
+{
+        if (live.fetch_sub(1) == 1)
+        {
+                {
+                        std::lock_guard<std::mutex> guard(idle_lock);
+                }
+                idle.notify_all();
+        }
+}
+
+void Scheduler::run()
+{
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < queues.size(); ++i)
+        {
+                workers.emplace_back(&Scheduler::worker_loop, this, i);
+        }
+
+        std::thread ticker;
+        if (frame_interval.count() > 0)
+        {
+                ticker = std::thread(&Scheduler::ticker_loop, this);
+        }
+
+        worker_loop(0);
+        for (auto &thread : workers)
+        {
+                thread.join();
+        }
+        if (ticker.joinable())
+        {
+                ticker.join();
+        }
+}
+
+void Scheduler::stop()
+{
+        stopping.store(true);
+        {
+                std::lock_guard<std::mutex> guard(idle_lock);
+        }
+        idle.notify_all();
+}
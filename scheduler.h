@@ -0,0 +1,147 @@
+#pragma once
+
+#include "chip8.h"
+#include "instance_pool.h"
+#include <sched.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Scheduler;
+
+// Coroutine type of an instance task. Starts suspended; the scheduler resumes
+// it and it destroys itself when it finishes.
+struct Task
+{
+        struct promise_type
+        {
+                Scheduler *scheduler{};
+
+                Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                auto final_suspend() noexcept;
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+};
+
+// One emulator run by the scheduler
+struct Instance
+{
+        enum State : int { RUNNABLE, PARKED };
+
+        Instance(Chip8 &chip8, unsigned int home) : chip8(chip8), home(home) {}
+
+        Chip8 &chip8;                        // in the home worker's pool
+        unsigned int id{};                   // spawn order
+        unsigned int home;                   // worker whose queue it returns to
+        std::atomic<uint16_t> keys{0};       // keypad bitmask, applied before each frame
+        std::atomic<int> state{RUNNABLE};
+        std::coroutine_handle<> handle;
+        uint64_t frames{};
+};
+
+// Cooperative scheduler for many instances on a fixed pool of workers.
+//
+// Each instance is a coroutine that runs one frame per resume, then yields.
+// An instance blocked on Fx0A parks until set_keys() gives it a key, and with
+// a frame interval an instance that finished its frame sleeps until the next
+// tick; neither sits in a run queue. Workers keep their own queues and steal
+// from each other when they run dry.
+//
+// Instances are spread over the workers in spawn order. Each worker has an
+// InstancePool on its NUMA node, and on machines with more than one node
+// workers are pinned to their node's CPUs. An instance's Chip8 comes from
+// its home worker's pool and it goes back on that worker's queue after each
+// frame, so it only leaves its node when stolen.
+class Scheduler
+{
+public:
+        // frame_interval of zero runs frames back to back. Without pooled,
+        // each Chip8 is a separate heap allocation, for comparison.
+        Scheduler(unsigned int workers, std::chrono::microseconds frame_interval, bool pooled = true);
+        ~Scheduler();
+
+        // Adds an instance that runs for frames frames. Call before run().
+        Instance &spawn(const Chip8 &initial, uint64_t frames);
+
+        // Thread-safe; wakes the instance if it is parked on Fx0A
+        void set_keys(Instance &instance, uint16_t keys);
+
+        // Runs until every instance finished or stop() is called
+        void run();
+        void stop();
+
+        size_t parked() const { return parked_count.load(std::memory_order_relaxed); }
+        // One per worker, empty when not pooled
+        std::vector<PoolStats> pool_stats() const;
+        std::vector<std::unique_ptr<Instance>> &instances() { return all; }
+
+        // Called on the worker thread after each frame an instance runs. Set
+        // before run(); never called for the same instance concurrently.
+        std::function<void(Instance &)> on_frame;
+
+private:
+        struct WorkerQueue
+        {
+                std::mutex lock;
+                std::deque<std::coroutine_handle<>> tasks;
+                bool pinned{};
+                cpu_set_t cpus;                      // of the worker's node when pinned
+        };
+
+        struct NextFrame;
+        struct KeyWait;
+        friend struct Task::promise_type;
+
+        Task instance_task(Instance &instance, uint64_t frames);
+        void enqueue(std::coroutine_handle<> task, unsigned int worker);
+        bool dequeue(unsigned int worker, std::coroutine_handle<> &task);
+        void worker_loop(unsigned int worker);
+        void ticker_loop();
+        void task_finished();
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+        // Outlive the instances referring to them
+        std::vector<std::unique_ptr<InstancePool>> pools;
+        std::vector<std::unique_ptr<Chip8>> unpooled;
+        std::vector<std::unique_ptr<Instance>> all;
+        std::chrono::microseconds frame_interval;
+
+        std::mutex idle_lock;
+        std::condition_variable idle;
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> live{0};
+        std::atomic<size_t> parked_count{0};
+        std::atomic<bool> stopping{false};
+
+        // Instances waiting for the next tick when frames are paced
+        std::mutex sleeping_lock;
+        std::vector<Instance *> sleeping;
+};
+
+inline auto Task::promise_type::final_suspend() noexcept
+{
+        struct Finished
+        {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> task) noexcept
+                {
+                        Scheduler *owner = task.promise().scheduler;
+                        task.destroy();
+                        owner->task_finished();
+                }
+                void await_resume() noexcept {}
+        };
+        return Finished{};
+}
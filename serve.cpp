@@ -0,0 +1,46 @@
+#include "stream_server.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+// Runs a ROM headless at 60 Hz and streams it to viewers, which also supply
+// the keys
+int main(int argc, char ** argv)
+{
+	if (argc < 3 || argc > 4) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Address> [Seconds]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	double seconds = (argc > 3) ? std::stod(argv[3]) : 0.0;
+
+	StreamServer server;
+	if (!server.listen(argv[2])) {
+		std::cerr << "Could not listen on " << argv[2] << " (expected unix:<Path> or tcp:<Port>)\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	// Instances all start from one seed; play a different game each run
+	Chip8 chip8;
+	chip8.seed(std::chrono::system_clock::now().time_since_epoch().count());
+	chip8.load_rom(argv[1]);
+	chip8.input = &server.keys();
+
+	auto period = std::chrono::microseconds(16667);
+	auto start = std::chrono::steady_clock::now();
+	auto next = start;
+	uint32_t frame = 0;
+	while (seconds <= 0 || std::chrono::steady_clock::now() - start < std::chrono::duration<double>(seconds)) {
+		chip8.run_frame();
+		server.publish(chip8, frame++);
+		next += period;
+		std::this_thread::sleep_until(next);
+	}
+	server.stop();
+
+	StreamStats stats = server.stats();
+	std::cout << frame << " frames, " << stats.encoded << " encoded, " << stats.skipped << " skipped unchanged, "
+	          << stats.keyframes << " keyframes, " << stats.accepted << " viewers, " << stats.bytes_sent
+	          << " bytes sent, " << stats.keys << " keys received\n";
+	return 0;
+}
@@ -0,0 +1,108 @@
+#include "shm_export.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <new>
+
+static_assert(VIDEO_WIDTH == SHM_WIDTH && VIDEO_HEIGHT == SHM_HEIGHT, "display does not match the shared layout");
+
+ShmExporter::~ShmExporter()
+{
+        if (base)
+        {
+                munmap(base, length);
+                shm_unlink(name.c_str());
+        }
+}
+
+bool ShmExporter::create(std::string shm_name, unsigned int instances, unsigned int ring_slots)
+{
+        if (base || instances == 0 || ring_slots == 0)
+        {
+                return false;
+        }
+
+        int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+                return false;
+        }
+
+        size_t size = shm_size(instances, ring_slots);
+        void *mapped = MAP_FAILED;
+        if (ftruncate(fd, size) == 0)
+        {
+                mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+                shm_unlink(shm_name.c_str());
+                return false;
+        }
+
+        // ftruncate zero-fills, which is every counter's starting value
+        name = shm_name;
+        base = mapped;
+        length = size;
+        header = new (base) ShmHeader{};
+        cursors = reinterpret_cast<ShmCursor *>(header + 1);
+        slots = reinterpret_cast<ShmSlot *>(cursors + instances);
+        for (unsigned int i = 0; i < instances; ++i)
+        {
+                new (&cursors[i]) ShmCursor{};
+        }
+        for (size_t i = 0; i < size_t(instances) * ring_slots; ++i)
+        {
+                new (&slots[i]) ShmSlot{};
+        }
+
+        std::memcpy(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+        header->instances = instances;
+        header->ring_slots = ring_slots;
+        header->slot_size = sizeof(ShmSlot);
+        header->version.store(SHM_VERSION, std::memory_order_release);
+        return true;
+}
+
+void ShmExporter::publish(unsigned int instance, const Chip8 &chip8, uint64_t frame)
+{
+        if (!header || instance >= header->instances)
+        {
+                return;
+        }
+        ShmSlot &slot = slots[size_t(instance) * header->ring_slots + frame % header->ring_slots];
+
+        uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint64_t v_low = 0, v_high = 0;
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+                v_low |= uint64_t(chip8.v_registers[i]) << (8 * i);
+                v_high |= uint64_t(chip8.v_registers[8 + i]) << (8 * i);
+        }
+        slot.frame.store(frame, std::memory_order_relaxed);
+        slot.v_low.store(v_low, std::memory_order_relaxed);
+        slot.v_high.store(v_high, std::memory_order_relaxed);
+        slot.control.store(uint64_t(chip8.pc) | uint64_t(chip8.index) << 16 | uint64_t(chip8.sp) << 32 |
+                               uint64_t(chip8.delay_timer) << 40 | uint64_t(chip8.sound_timer) << 48,
+                           std::memory_order_relaxed);
+
+        for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+        {
+                const uint32_t *pixels = &chip8.display[row * VIDEO_WIDTH];
+                uint64_t bits = 0;
+                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                {
+                        bits = (bits << 1) | (pixels[x] ? 1u : 0u);
+                }
+                slot.rows[row].store(bits, std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        cursors[instance].published.store(frame + 1, std::memory_order_release);
+}
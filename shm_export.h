@@ -0,0 +1,35 @@
+#pragma once
+
+#include "chip8.h"
+#include "shm_layout.h"
+#include <string>
+
+// Publishes instance frames into POSIX shared memory for other processes;
+// see shm_layout.h for the format and ShmReader for the other side.
+// Publishing never waits for readers. Each instance must be published from
+// one thread at a time; different instances may publish concurrently.
+class ShmExporter
+{
+public:
+        ShmExporter() = default;
+        ~ShmExporter();
+
+        ShmExporter(const ShmExporter &) = delete;
+        ShmExporter &operator=(const ShmExporter &) = delete;
+
+        // Creates (or replaces) the shm_open object name, unlinked again on
+        // destruction. ring_slots frames per instance stay readable.
+        bool create(std::string name, unsigned int instances, unsigned int ring_slots = 4);
+
+        // Stores display, registers and frame number into the next slot of
+        // the instance's ring
+        void publish(unsigned int instance, const Chip8 &chip8, uint64_t frame);
+
+private:
+        std::string name;
+        void *base{nullptr};
+        size_t length{};
+        ShmHeader *header{nullptr};
+        ShmCursor *cursors{nullptr};
+        ShmSlot *slots{nullptr};
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Layout of the POSIX shared memory object written by ShmExporter and read
+// by ShmReader. Kept free of chip8.h so consumers only need this header and
+// shm_reader.h.
+//
+//   ShmHeader
+//   ShmCursor[instances]
+//   ShmSlot[instances][ring_slots]
+//
+// Each instance owns a ring of slots. A slot is a seqlock: the writer makes
+// sequence odd, stores the payload, then makes it even again. A reader that
+// sees the same even sequence before and after copying got a consistent
+// frame; otherwise it retries. Every payload field is a relaxed atomic so
+// the race a seqlock relies on stays defined.
+
+const char SHM_MAGIC[4] = {'C', '8', 'S', 'H'};
+const uint32_t SHM_VERSION = 1;
+
+const unsigned int SHM_WIDTH = 64;
+const unsigned int SHM_HEIGHT = 32;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock-free 64-bit atomics");
+
+struct alignas(64) ShmHeader
+{
+        char magic[4];
+        std::atomic<uint32_t> version;     // stored last, once the layout is filled in
+        uint32_t instances;
+        uint32_t ring_slots;
+        uint32_t slot_size;                // sizeof(ShmSlot) of the writer
+};
+
+struct alignas(64) ShmCursor
+{
+        std::atomic<uint64_t> published;   // frames published, the newest is in slot (published - 1) % ring_slots
+};
+
+struct alignas(64) ShmSlot
+{
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint64_t> frame;
+        std::atomic<uint64_t> v_low;       // v0-v7, v0 in the low byte
+        std::atomic<uint64_t> v_high;      // v8-vf
+        std::atomic<uint64_t> control;     // pc | index << 16 | sp << 32 | delay << 40 | sound << 48
+        std::atomic<uint64_t> rows[SHM_HEIGHT];    // one bit per pixel, x = 0 in bit 63
+};
+
+inline size_t shm_size(uint32_t instances, uint32_t ring_slots)
+{
+        return sizeof(ShmHeader) + instances * sizeof(ShmCursor) + size_t(instances) * ring_slots * sizeof(ShmSlot);
+}
@@ -0,0 +1,129 @@
+#include "shm_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+const unsigned int MAX_READ_ATTEMPTS = 64;
+
+ShmReader::~ShmReader()
+{
+        if (base)
+        {
+                munmap(base, length);
+        }
+}
+
+bool ShmReader::open(std::string name)
+{
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+                return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(ShmHeader))
+        {
+                close(fd);
+                return false;
+        }
+
+        void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+                return false;
+        }
+
+        auto candidate = static_cast<const ShmHeader *>(mapped);
+        if (std::memcmp(candidate->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 ||
+            candidate->version.load(std::memory_order_acquire) != SHM_VERSION ||
+            candidate->slot_size != sizeof(ShmSlot) || candidate->ring_slots == 0 ||
+            shm_size(candidate->instances, candidate->ring_slots) > size_t(info.st_size))
+        {
+                munmap(mapped, info.st_size);
+                return false;
+        }
+
+        if (base)
+        {
+                munmap(base, length);
+        }
+        base = mapped;
+        length = info.st_size;
+        header = candidate;
+        cursors = reinterpret_cast<const ShmCursor *>(header + 1);
+        slots = reinterpret_cast<const ShmSlot *>(cursors + header->instances);
+        return true;
+}
+
+uint64_t ShmReader::published(unsigned int instance) const
+{
+        if (instance >= instances())
+        {
+                return 0;
+        }
+        return cursors[instance].published.load(std::memory_order_acquire);
+}
+
+bool ShmReader::read_latest(unsigned int instance, ShmFrame &out) const
+{
+        uint64_t count = published(instance);
+        return count > 0 && read_slot(instance, count - 1, out);
+}
+
+bool ShmReader::read(unsigned int instance, uint64_t frame, ShmFrame &out) const
+{
+        return read_slot(instance, frame, out) && out.frame == frame;
+}
+
+bool ShmReader::read_slot(unsigned int instance, uint64_t frame, ShmFrame &out) const
+{
+        if (instance >= instances())
+        {
+                return false;
+        }
+        const ShmSlot &slot = slots[size_t(instance) * header->ring_slots + frame % header->ring_slots];
+
+        for (unsigned int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+        {
+                uint32_t before = slot.sequence.load(std::memory_order_acquire);
+                if (before & 1u)
+                {
+                        ++retry_count;
+                        continue;
+                }
+
+                out.frame = slot.frame.load(std::memory_order_relaxed);
+                uint64_t v_low = slot.v_low.load(std::memory_order_relaxed);
+                uint64_t v_high = slot.v_high.load(std::memory_order_relaxed);
+                uint64_t control = slot.control.load(std::memory_order_relaxed);
+                for (unsigned int row = 0; row < SHM_HEIGHT; ++row)
+                {
+                        out.rows[row] = slot.rows[row].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != before)
+                {
+                        ++retry_count;
+                        continue;
+                }
+
+                for (unsigned int i = 0; i < 8; ++i)
+                {
+                        out.v[i] = v_low >> (8 * i);
+                        out.v[8 + i] = v_high >> (8 * i);
+                }
+                out.pc = control;
+                out.index = control >> 16;
+                out.sp = control >> 32;
+                out.delay = control >> 40;
+                out.sound = control >> 48;
+                return true;
+        }
+        return false;
+}
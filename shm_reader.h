@@ -0,0 +1,60 @@
+#pragma once
+
+#include "shm_layout.h"
+#include <stddef.h>
+#include <string>
+
+// One consistent snapshot of an instance
+struct ShmFrame
+{
+        uint64_t frame;
+        uint8_t v[16];
+        uint16_t pc;
+        uint16_t index;
+        uint8_t sp;
+        uint8_t delay;
+        uint8_t sound;
+        uint64_t rows[SHM_HEIGHT];
+
+        bool pixel(unsigned int x, unsigned int y) const { return (rows[y] >> (SHM_WIDTH - 1 - x)) & 1u; }
+};
+
+// Maps an exporter's shared memory read-only. Reads never block the writer;
+// a reader racing the writer just retries.
+class ShmReader
+{
+public:
+        ShmReader() = default;
+        ~ShmReader();
+
+        ShmReader(const ShmReader &) = delete;
+        ShmReader &operator=(const ShmReader &) = delete;
+
+        // name is the shm_open name, e.g. "/chip8"
+        bool open(std::string name);
+
+        unsigned int instances() const { return header ? header->instances : 0; }
+
+        // Frames the writer has published for instance so far
+        uint64_t published(unsigned int instance) const;
+
+        // Copies the newest frame of instance. Returns false if nothing was
+        // published yet or the writer kept overwriting the slot.
+        bool read_latest(unsigned int instance, ShmFrame &out) const;
+
+        // Copies frame number frame if it is still in the ring
+        bool read(unsigned int instance, uint64_t frame, ShmFrame &out) const;
+
+        // Times a read found a slot mid-write and retried
+        uint64_t retries() const { return retry_count; }
+
+private:
+        bool read_slot(unsigned int instance, uint64_t frame, ShmFrame &out) const;
+
+        void *base{nullptr};
+        size_t length{};
+        const ShmHeader *header{nullptr};
+        const ShmCursor *cursors{nullptr};
+        const ShmSlot *slots{nullptr};
+        mutable uint64_t retry_count{};
+};
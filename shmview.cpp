@@ -0,0 +1,77 @@
+#include "shm_reader.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2 || argc > 4) {
+		std::cerr << "Usage: " << argv[0] << " <ShmName> [Instance] [Seconds]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	unsigned int instance = (argc > 2) ? std::stoi(argv[2]) : 0;
+	double seconds = (argc > 3) ? std::stod(argv[3]) : 5.0;
+
+	// The producer may not have created the object yet
+	ShmReader reader;
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::duration<double>(seconds);
+	while (!reader.open(argv[1])) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			std::cerr << "Could not open shared memory " << argv[1] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (instance >= reader.instances()) {
+		std::cerr << argv[1] << " has " << reader.instances() << " instances\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	// Polls the newest frame, counting frames the producer got ahead by
+	ShmFrame frame{};
+	bool have_frame = false;
+	uint64_t seen = 0, skipped = 0, last = 0;
+	while (std::chrono::steady_clock::now() < deadline) {
+		ShmFrame latest;
+		if (reader.read_latest(instance, latest) && (!have_frame || latest.frame != last)) {
+			if (have_frame && latest.frame > last + 1) {
+				skipped += latest.frame - last - 1;
+			}
+			frame = latest;
+			last = latest.frame;
+			have_frame = true;
+			++seen;
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+	}
+
+	if (!have_frame) {
+		std::cerr << "No frames published for instance " << instance << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	for (unsigned int y = 0; y < SHM_HEIGHT; ++y) {
+		std::string line;
+		for (unsigned int x = 0; x < SHM_WIDTH; ++x) {
+			line += frame.pixel(x, y) ? '#' : '.';
+		}
+		std::cout << line << "\n";
+	}
+
+	char regs[128];
+	std::snprintf(regs, sizeof(regs), "frame %llu pc %03x i %03x sp %u dt %u st %u\n",
+	              (unsigned long long)frame.frame, frame.pc, frame.index, frame.sp, frame.delay, frame.sound);
+	std::cout << regs;
+	for (unsigned int i = 0; i < 16; ++i) {
+		std::snprintf(regs, sizeof(regs), "v%x=%02x%s", i, frame.v[i], (i == 15) ? "\n" : " ");
+		std::cout << regs;
+	}
+	std::cout << seen << " frames read, " << skipped << " skipped, " << reader.retries() << " retries\n";
+	return 0;
+}
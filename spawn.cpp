@@ -0,0 +1,81 @@
+#include "chip8.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Measures what it costs to get an instance with a ROM loaded, by building
+// new ones and by resetting existing ones, over a set of Instances slots so
+// the working set can be made larger than the caches. With Frames each
+// instance then runs that many frames, so resets have something to undo.
+int main(int argc, char ** argv)
+{
+	if (argc < 2 || argc > 5) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> [Instances] [Rounds] [Frames]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	unsigned int instances = (argc > 2) ? std::stoi(argv[2]) : 1;
+	unsigned int rounds = (argc > 3) ? std::stoi(argv[3]) : 100000 / std::max(1u, instances) + 1;
+	unsigned int frames = (argc > 4) ? std::stoi(argv[4]) : 0;
+	if (instances == 0) {
+		std::cerr << "Instances must be at least 1\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Could not read " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	MemoryImage image;
+	image.load_rom(rom.data(), rom.size());
+	Chip8 prototype(image);
+
+	std::unique_ptr<Chip8[]> slots(new Chip8[instances]);
+	// Read back so the work cannot be optimised away
+	volatile uint32_t version = 0;
+	auto measure = [&](const char *name, auto &&make) {
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int round = 0; round < rounds; ++round) {
+			for (unsigned int i = 0; i < instances; ++i) {
+				make(slots[i]);
+				for (unsigned int frame = 0; frame < frames; ++frame) {
+					slots[i].run_frame();
+				}
+				version = slots[i].display_version();
+			}
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-28s %8.1f ns\n", name, ns / (double(rounds) * instances));
+		std::cout << line;
+	};
+
+	measure("construct, load_rom", [&](Chip8 &slot) {
+		slot.~Chip8();
+		new (&slot) Chip8();
+		slot.load_rom(rom.data(), rom.size());
+	});
+	measure("construct from image", [&](Chip8 &slot) {
+		slot.~Chip8();
+		new (&slot) Chip8(image);
+	});
+	measure("copy of prototype", [&](Chip8 &slot) { slot = prototype; });
+	measure("reset, load_rom", [&](Chip8 &slot) {
+		slot.reset();
+		slot.load_rom(rom.data(), rom.size());
+	});
+	measure("reset from image", [&](Chip8 &slot) { slot.reset(image); });
+
+	std::cout << sizeof(Chip8) << " bytes per instance, " << instances << " instances, " << rounds << " rounds, "
+	          << frames << " frames each\n";
+	return 0;
+}
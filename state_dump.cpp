@@ -0,0 +1,284 @@
+#include "state_dump.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+
+// Gaps shorter than a run header are cheaper to send than to split on
+const unsigned int DIFF_MERGE_GAP = 4;
+
+StateDumper::StateDumper()
+{
+        out.reserve(64 + 2 * MEMORY_SIZE);
+}
+
+void StateDumper::put16(uint16_t value)
+{
+        out.push_back(value & 0xffu);
+        out.push_back(value >> 8u);
+}
+
+void StateDumper::put32(uint32_t value)
+{
+        put16(value & 0xffffu);
+        put16(value >> 16u);
+}
+
+size_t StateDumper::begin_section(unsigned int tag)
+{
+        put8(tag);
+        size_t offset = out.size();
+        put32(0);
+        return offset;
+}
+
+void StateDumper::end_section(size_t length_offset)
+{
+        uint32_t length = out.size() - length_offset - 4;
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+                out[length_offset + i] = (length >> (8 * i)) & 0xffu;
+        }
+}
+
+const std::vector<uint8_t> &StateDumper::capture(const Chip8 &chip8, unsigned int sections,
+                                                 uint16_t start, uint16_t length)
+{
+        if (start >= MEMORY_SIZE)
+        {
+                start = 0;
+                length = 0;
+        }
+        if (start + length > MEMORY_SIZE)
+        {
+                length = MEMORY_SIZE - start;
+        }
+
+        out.clear();
+        for (char ch : STATE_DUMP_MAGIC)
+        {
+                put8(ch);
+        }
+        put8(STATE_DUMP_VERSION);
+        put32(sequence++);
+
+        if (sections & DUMP_REGS)
+        {
+                size_t section = begin_section(DUMP_REGS);
+                put16(chip8.pc);
+                put16(chip8.index);
+                put8(chip8.sp);
+                put8(chip8.delay_timer);
+                put8(chip8.sound_timer);
+                out.insert(out.end(), chip8.v_registers.begin(), chip8.v_registers.end());
+                for (uint16_t level : chip8.stack)
+                {
+                        put16(level);
+                }
+                end_section(section);
+        }
+
+        if (sections & DUMP_MEMORY)
+        {
+                size_t section = begin_section(DUMP_MEMORY);
+                put16(start);
+                out.insert(out.end(), chip8.memory.begin() + start, chip8.memory.begin() + start + length);
+                end_section(section);
+        }
+
+        if (sections & DUMP_DIFF)
+        {
+                size_t section = begin_section(DUMP_DIFF);
+                unsigned int end = start + length;
+                unsigned int addr = start;
+
+                while (addr < end)
+                {
+                        if (have_baseline && chip8.memory[addr] == baseline[addr])
+                        {
+                                ++addr;
+                                continue;
+                        }
+
+                        // Extend the run until DIFF_MERGE_GAP unchanged bytes in a row
+                        unsigned int run_end = addr + 1;
+                        unsigned int same = 0;
+                        for (unsigned int i = run_end; i < end && same < DIFF_MERGE_GAP; ++i)
+                        {
+                                if (have_baseline && chip8.memory[i] == baseline[i])
+                                {
+                                        ++same;
+                                }
+                                else
+                                {
+                                        same = 0;
+                                        run_end = i + 1;
+                                }
+                        }
+
+                        put16(addr);
+                        put16(run_end - addr);
+                        out.insert(out.end(), chip8.memory.begin() + addr, chip8.memory.begin() + run_end);
+                        addr = run_end;
+                }
+
+                std::copy(chip8.memory.begin() + start, chip8.memory.begin() + end, baseline.begin() + start);
+                have_baseline = true;
+                end_section(section);
+        }
+
+        if (sections & DUMP_DISPLAY)
+        {
+                size_t section = begin_section(DUMP_DISPLAY);
+                for (unsigned int i = 0; i < chip8.display.size(); i += 8)
+                {
+                        uint8_t bits = 0;
+                        for (unsigned int bit = 0; bit < 8; ++bit)
+                        {
+                                if (chip8.display[i + bit])
+                                {
+                                        bits |= 0x80u >> bit;
+                                }
+                        }
+                        put8(bits);
+                }
+                end_section(section);
+        }
+
+        return out;
+}
+
+bool StateDumper::write(int fd) const
+{
+        size_t written = 0;
+        while (written < out.size())
+        {
+                ssize_t result = ::write(fd, out.data() + written, out.size() - written);
+                if (result <= 0)
+                {
+                        return false;
+                }
+                written += result;
+        }
+        return true;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+        return p[0] | (p[1] << 8u);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+        return get16(p) | (get16(p + 2) << 16u);
+}
+
+static void append_hex_rows(std::string &text, const uint8_t *bytes, unsigned int address, unsigned int count)
+{
+        char line[80];
+        for (unsigned int i = 0; i < count; i += 16)
+        {
+                int used = std::snprintf(line, sizeof(line), "%03x:", address + i);
+                for (unsigned int j = i; j < i + 16 && j < count; ++j)
+                {
+                        used += std::snprintf(line + used, sizeof(line) - used, " %02x", bytes[j]);
+                }
+                text.append(line, used);
+                text += '\n';
+        }
+}
+
+bool format_state_dump(const uint8_t *data, size_t size, std::string &text)
+{
+        const uint8_t *p = data;
+        const uint8_t *end = data + size;
+        char line[160];
+        const size_t header_size = sizeof(STATE_DUMP_MAGIC) + 5;
+
+        while (p < end)
+        {
+                if (end - p < static_cast<long>(header_size) ||
+                    !std::equal(STATE_DUMP_MAGIC, STATE_DUMP_MAGIC + sizeof(STATE_DUMP_MAGIC), p) ||
+                    p[4] != STATE_DUMP_VERSION)
+                {
+                        return false;
+                }
+
+                std::snprintf(line, sizeof(line), "dump #%u\n", get32(p + 5));
+                text += line;
+                p += header_size;
+
+                // Section tags never collide with the first magic byte
+                while (p < end && p[0] != STATE_DUMP_MAGIC[0])
+                {
+                        if (end - p < 5)
+                        {
+                                return false;
+                        }
+                        unsigned int tag = p[0];
+                        uint32_t length = get32(p + 1);
+                        const uint8_t *payload = p + 5;
+                        if (static_cast<size_t>(end - payload) < length)
+                        {
+                                return false;
+                        }
+
+                        if (tag == DUMP_REGS && length == 55)
+                        {
+                                std::snprintf(line, sizeof(line), "pc %03x  I %03x  sp %u  dt %u  st %u\n",
+                                              get16(payload), get16(payload + 2), payload[4], payload[5], payload[6]);
+                                text += line;
+                                for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+                                {
+                                        std::snprintf(line, sizeof(line), "V%X=%02x%c", i, payload[7 + i], i % 8 == 7 ? '\n' : ' ');
+                                        text += line;
+                                }
+                                text += "stack:";
+                                for (unsigned int i = 0; i < STACK_LEVELS; ++i)
+                                {
+                                        std::snprintf(line, sizeof(line), " %03x", get16(payload + 23 + 2 * i));
+                                        text += line;
+                                }
+                                text += '\n';
+                        }
+                        else if (tag == DUMP_MEMORY && length >= 2)
+                        {
+                                append_hex_rows(text, payload + 2, get16(payload), length - 2);
+                        }
+                        else if (tag == DUMP_DIFF)
+                        {
+                                const uint8_t *run = payload;
+                                while (run + 4 <= payload + length)
+                                {
+                                        unsigned int count = get16(run + 2);
+                                        if (run + 4 + count > payload + length)
+                                        {
+                                                return false;
+                                        }
+                                        append_hex_rows(text, run + 4, get16(run), count);
+                                        run += 4 + count;
+                                }
+                        }
+                        else if (tag == DUMP_DISPLAY && length == VIDEO_WIDTH * VIDEO_HEIGHT / 8)
+                        {
+                                for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+                                {
+                                        for (unsigned int col = 0; col < VIDEO_WIDTH; ++col)
+                                        {
+                                                unsigned int pixel = row * VIDEO_WIDTH + col;
+                                                text += (payload[pixel / 8] & (0x80u >> (pixel % 8))) ? '#' : '.';
+                                        }
+                                        text += '\n';
+                                }
+                        }
+                        else
+                        {
+                                return false;
+                        }
+
+                        p = payload + length;
+                }
+        }
+
+        return true;
+}
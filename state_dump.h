@@ -0,0 +1,58 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <string>
+#include <vector>
+
+// Binary state dump format, all integers little-endian:
+//
+//   "C8SD" version:u8 sequence:u32
+//   then sections, each tag:u8 length:u32 payload
+//
+//   DUMP_REGS     pc:u16 index:u16 sp:u8 delay:u8 sound:u8 v[16] stack[16]:u16
+//   DUMP_MEMORY   start:u16 bytes
+//   DUMP_DIFF     runs of start:u16 count:u16 bytes, against the previous diff
+//   DUMP_DISPLAY  64x32 pixels, one bit each, MSB first
+
+const char STATE_DUMP_MAGIC[4] = {'C', '8', 'S', 'D'};
+const uint8_t STATE_DUMP_VERSION = 1;
+
+const unsigned int DUMP_REGS = 0x1;
+const unsigned int DUMP_MEMORY = 0x2;
+const unsigned int DUMP_DIFF = 0x4;
+const unsigned int DUMP_DISPLAY = 0x8;
+
+class StateDumper
+{
+public:
+        StateDumper();
+
+        // Serializes the chosen sections into buffer(). DUMP_MEMORY covers
+        // [start, start + length); DUMP_DIFF covers the same range and only
+        // the bytes that changed since the previous DUMP_DIFF capture.
+        const std::vector<uint8_t> &capture(const Chip8 &chip8, unsigned int sections,
+                                            uint16_t start = 0, uint16_t length = MEMORY_SIZE);
+
+        // Writes the last capture with a single write(2)
+        bool write(int fd) const;
+
+        const std::vector<uint8_t> &buffer() const { return out; }
+
+private:
+        void put8(uint8_t value) { out.push_back(value); }
+        void put16(uint16_t value);
+        void put32(uint32_t value);
+        size_t begin_section(unsigned int tag);
+        void end_section(size_t length_offset);
+
+        std::vector<uint8_t> out;
+        std::array<uint8_t, MEMORY_SIZE> baseline{};
+        bool have_baseline{};
+        uint32_t sequence{};
+};
+
+// Appends a readable rendering of one or more concatenated dumps to text.
+// Returns false if the data is malformed.
+bool format_state_dump(const uint8_t *data, size_t size, std::string &text);
@@ -0,0 +1,190 @@
+#include "stream_client.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+
+StreamClient::~StreamClient()
+{
+        close();
+}
+
+bool StreamClient::connect(const std::string &text)
+{
+        StreamAddress address;
+        if (!parse_stream_address(text.c_str(), address))
+        {
+                return false;
+        }
+        close();
+
+        int fd = socket(address.unix_socket ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+                return false;
+        }
+
+        int connected = -1;
+        if (address.unix_socket)
+        {
+                sockaddr_un remote{};
+                remote.sun_family = AF_UNIX;
+                std::strcpy(remote.sun_path, address.path);
+                connected = ::connect(fd, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+        }
+        else
+        {
+                sockaddr_in remote{};
+                remote.sin_family = AF_INET;
+                remote.sin_port = htons(address.port);
+                remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                connected = ::connect(fd, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+                int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        }
+        if (connected != 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+        {
+                ::close(fd);
+                return false;
+        }
+
+        socket_fd = fd;
+        return true;
+}
+
+void StreamClient::close()
+{
+        if (socket_fd >= 0)
+        {
+                ::close(socket_fd);
+        }
+        socket_fd = -1;
+        input.clear();
+        output.clear();
+        display.fill(0);
+        greeted = false;
+        frame_number = 0;
+}
+
+bool StreamClient::poll()
+{
+        if (socket_fd < 0 || !flush())
+        {
+                return false;
+        }
+
+        uint8_t buffer[4096];
+        for (;;)
+        {
+                ssize_t length = recv(socket_fd, buffer, sizeof(buffer), 0);
+                if (length == 0)
+                {
+                        return false;
+                }
+                if (length < 0)
+                {
+                        if (errno == EINTR)
+                        {
+                                continue;
+                        }
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        {
+                                return false;
+                        }
+                        break;
+                }
+                received_bytes += length;
+                input.insert(input.end(), buffer, buffer + length);
+        }
+
+        size_t used = 0;
+        while (input.size() - used >= STREAM_HEADER_SIZE)
+        {
+                const uint8_t *header = input.data() + used;
+                size_t length = stream_get16(header + 2);
+                if (length > STREAM_MAX_PAYLOAD)
+                {
+                        return false;
+                }
+                if (input.size() - used < STREAM_HEADER_SIZE + length)
+                {
+                        break;
+                }
+                if (!apply(header[0], header[1], header + STREAM_HEADER_SIZE, length))
+                {
+                        return false;
+                }
+                used += STREAM_HEADER_SIZE + length;
+        }
+        input.erase(input.begin(), input.begin() + used);
+        return true;
+}
+
+bool StreamClient::apply(uint8_t type, uint8_t flags, const uint8_t *payload, size_t length)
+{
+        if (type == STREAM_HELLO)
+        {
+                greeted = length == STREAM_HELLO_SIZE && std::memcmp(payload, STREAM_MAGIC, sizeof(STREAM_MAGIC)) == 0 &&
+                          payload[4] == STREAM_VERSION && payload[5] == STREAM_WIDTH && payload[6] == STREAM_HEIGHT;
+                return greeted;
+        }
+        if (type != STREAM_FRAME || !greeted || length < 8)
+        {
+                return false;
+        }
+
+        uint32_t mask = stream_get32(payload + 4);
+        if (length != 8 + 8 * size_t(__builtin_popcount(mask)) || ((flags & STREAM_KEYFRAME) && mask != 0xffffffffu))
+        {
+                return false;
+        }
+        const uint8_t *row_data = payload + 8;
+        for (unsigned int row = 0; row < STREAM_HEIGHT; ++row)
+        {
+                if (mask & (1u << row))
+                {
+                        display[row] = stream_get64(row_data);
+                        row_data += 8;
+                }
+        }
+        frame_number = stream_get32(payload);
+        ++frame_count;
+        keyframe_count += (flags & STREAM_KEYFRAME) != 0;
+        return true;
+}
+
+bool StreamClient::send_key(uint8_t key, bool down)
+{
+        if (socket_fd < 0 || key >= 16)
+        {
+                return false;
+        }
+        uint8_t packet[STREAM_HEADER_SIZE + STREAM_KEY_SIZE] = {STREAM_KEY, 0, 0, 0, key, uint8_t(down)};
+        stream_put16(packet + 2, STREAM_KEY_SIZE);
+        output.insert(output.end(), packet, packet + sizeof(packet));
+        return flush();
+}
+
+bool StreamClient::flush()
+{
+        while (!output.empty())
+        {
+                ssize_t sent = send(socket_fd, output.data(), output.size(), MSG_NOSIGNAL);
+                if (sent < 0)
+                {
+                        if (errno == EINTR)
+                        {
+                                continue;
+                        }
+                        return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+                output.erase(output.begin(), output.begin() + sent);
+        }
+        return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "stream_protocol.h"
+#include <stddef.h>
+#include <array>
+#include <string>
+#include <vector>
+
+// One viewer of a StreamServer: keeps a copy of the served display up to date
+// from the packets it receives and sends keypad events back.
+class StreamClient
+{
+public:
+        StreamClient() = default;
+        ~StreamClient();
+
+        StreamClient(const StreamClient &) = delete;
+        StreamClient &operator=(const StreamClient &) = delete;
+
+        // address as for StreamServer::listen
+        bool connect(const std::string &address);
+        void close();
+
+        // For poll(2) or epoll; -1 when not connected
+        int fd() const { return socket_fd; }
+
+        // Reads whatever has arrived without blocking and applies it. Returns
+        // false once the server closed the stream or sent something invalid.
+        bool poll();
+
+        // Queues a key event; sent now if the socket takes it, else by poll()
+        bool send_key(uint8_t key, bool down);
+
+        // The server's HELLO has arrived, so rows() describes its display
+        bool ready() const { return greeted; }
+
+        const std::array<uint64_t, STREAM_HEIGHT> &rows() const { return display; }
+        bool pixel(unsigned int x, unsigned int y) const { return (display[y] >> (STREAM_WIDTH - 1 - x)) & 1u; }
+
+        // Server frame number of the last frame packet applied
+        uint32_t frame() const { return frame_number; }
+
+        uint64_t frames() const { return frame_count; }
+        uint64_t keyframes() const { return keyframe_count; }
+        uint64_t bytes_received() const { return received_bytes; }
+
+private:
+        bool apply(uint8_t type, uint8_t flags, const uint8_t *payload, size_t length);
+        bool flush();
+
+        int socket_fd{-1};
+        std::vector<uint8_t> input;          // bytes of packets not yet complete
+        std::vector<uint8_t> output;         // key packets the socket has not taken yet
+        std::array<uint64_t, STREAM_HEIGHT> display{};
+        bool greeted{};
+        uint32_t frame_number{};
+        uint64_t frame_count{};
+        uint64_t keyframe_count{};
+        uint64_t received_bytes{};
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+
+// Wire format between StreamServer and StreamClient, over a Unix domain or
+// loopback TCP stream socket. Kept free of chip8.h so viewers only need
+// this header and stream_client.h. All integers are little-endian.
+//
+// Every packet is a 4 byte header, type:u8 flags:u8 length:u16, then
+// length bytes of payload.
+//
+//   STREAM_HELLO  server, first packet: magic[4] version:u8 width:u8 height:u8 pad:u8
+//   STREAM_FRAME  server: frame:u32 rows:u32, then one u64 per bit set in
+//                 rows, lowest row first. A row packs its 64 pixels with the
+//                 leftmost in the most significant bit. With STREAM_KEYFRAME
+//                 set rows covers the whole display, otherwise only rows that
+//                 changed since the previous frame packet.
+//   STREAM_KEY    client: key:u8 down:u8
+
+const char STREAM_MAGIC[4] = {'C', '8', 'S', 'T'};
+const uint8_t STREAM_VERSION = 1;
+
+const unsigned int STREAM_WIDTH = 64;
+const unsigned int STREAM_HEIGHT = 32;
+
+const uint8_t STREAM_HELLO = 1;
+const uint8_t STREAM_FRAME = 2;
+const uint8_t STREAM_KEY = 3;
+
+const uint8_t STREAM_KEYFRAME = 0x1;
+
+const unsigned int STREAM_HEADER_SIZE = 4;
+const unsigned int STREAM_HELLO_SIZE = 8;
+const unsigned int STREAM_KEY_SIZE = 2;
+const unsigned int STREAM_MAX_PAYLOAD = 8 + 8 * STREAM_HEIGHT;
+
+inline void stream_put16(uint8_t *out, uint16_t value)
+{
+        out[0] = value & 0xff;
+        out[1] = value >> 8;
+}
+
+inline void stream_put32(uint8_t *out, uint32_t value)
+{
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+                out[i] = (value >> (8 * i)) & 0xff;
+        }
+}
+
+inline void stream_put64(uint8_t *out, uint64_t value)
+{
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+                out[i] = (value >> (8 * i)) & 0xff;
+        }
+}
+
+inline uint16_t stream_get16(const uint8_t *in)
+{
+        return in[0] | (in[1] << 8);
+}
+
+inline uint32_t stream_get32(const uint8_t *in)
+{
+        uint32_t value = 0;
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+                value |= uint32_t(in[i]) << (8 * i);
+        }
+        return value;
+}
+
+inline uint64_t stream_get64(const uint8_t *in)
+{
+        uint64_t value = 0;
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+                value |= uint64_t(in[i]) << (8 * i);
+        }
+        return value;
+}
+
+// "unix:<path>" or "tcp:<port>"; TCP is bound to and dialled on 127.0.0.1.
+// Returns false for anything else.
+struct StreamAddress
+{
+        bool unix_socket;
+        char path[108];
+        uint16_t port;
+};
+
+inline bool parse_stream_address(const char *text, StreamAddress &address)
+{
+        address = StreamAddress{};
+        if (std::strncmp(text, "unix:", 5) == 0 && text[5] && std::strlen(text + 5) < sizeof(address.path))
+        {
+                address.unix_socket = true;
+                std::strcpy(address.path, text + 5);
+                return true;
+        }
+        if (std::strncmp(text, "tcp:", 4) == 0)
+        {
+                char *end = nullptr;
+                unsigned long port = std::strtoul(text + 4, &end, 10);
+                if (end != text + 4 && *end == '\0' && port > 0 && port < 65536)
+                {
+                        address.port = port;
+                        return true;
+                }
+        }
+        return false;
+}
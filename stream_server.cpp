@@ -0,0 +1,507 @@
+#include "stream_server.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+static_assert(VIDEO_WIDTH == STREAM_WIDTH && VIDEO_HEIGHT == STREAM_HEIGHT, "display does not match the stream");
+
+const unsigned int MAX_EVENTS = 64;
+const unsigned int MAX_IOVECS = 64;
+
+static std::shared_ptr<const std::vector<uint8_t>> encode_frame(uint8_t flags, uint32_t frame, uint32_t mask, const uint64_t *rows)
+{
+        auto packet = std::make_shared<std::vector<uint8_t>>(STREAM_HEADER_SIZE + 8 + 8 * __builtin_popcount(mask));
+        uint8_t *out = packet->data();
+        out[0] = STREAM_FRAME;
+        out[1] = flags;
+        stream_put16(out + 2, packet->size() - STREAM_HEADER_SIZE);
+        stream_put32(out + 4, frame);
+        stream_put32(out + 8, mask);
+        out += 12;
+        for (unsigned int row = 0; row < STREAM_HEIGHT; ++row)
+        {
+                if (mask & (1u << row))
+                {
+                        stream_put64(out, rows[row]);
+                        out += 8;
+                }
+        }
+        return packet;
+}
+
+StreamServer::~StreamServer()
+{
+        stop();
+}
+
+bool StreamServer::listen(const std::string &text)
+{
+        StreamAddress address;
+        if (listen_fd >= 0 || !parse_stream_address(text.c_str(), address))
+        {
+                return false;
+        }
+
+        int fd = socket(address.unix_socket ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+                return false;
+        }
+
+        int bound = -1;
+        if (address.unix_socket)
+        {
+                // A socket file left by an earlier server would make bind fail
+                unlink(address.path);
+                sockaddr_un local{};
+                local.sun_family = AF_UNIX;
+                std::strcpy(local.sun_path, address.path);
+                bound = bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local));
+        }
+        else
+        {
+                int reuse = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                sockaddr_in local{};
+                local.sin_family = AF_INET;
+                local.sin_port = htons(address.port);
+                local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                bound = bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local));
+        }
+        if (bound != 0 || ::listen(fd, SOMAXCONN) != 0)
+        {
+                close(fd);
+                return false;
+        }
+
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        bool watching = epoll_fd >= 0 && wake_fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+        event.data.fd = wake_fd;
+        if (!watching || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) != 0)
+        {
+                close(fd);
+                if (epoll_fd >= 0)
+                {
+                        close(epoll_fd);
+                }
+                if (wake_fd >= 0)
+                {
+                        close(wake_fd);
+                }
+                epoll_fd = wake_fd = -1;
+                return false;
+        }
+
+        listen_fd = fd;
+        unix_socket = address.unix_socket;
+        unix_path = address.unix_socket ? address.path : "";
+
+        auto greeting = std::make_shared<std::vector<uint8_t>>(STREAM_HEADER_SIZE + STREAM_HELLO_SIZE);
+        uint8_t *out = greeting->data();
+        out[0] = STREAM_HELLO;
+        stream_put16(out + 2, STREAM_HELLO_SIZE);
+        std::memcpy(out + 4, STREAM_MAGIC, sizeof(STREAM_MAGIC));
+        out[8] = STREAM_VERSION;
+        out[9] = STREAM_WIDTH;
+        out[10] = STREAM_HEIGHT;
+        hello = greeting;
+
+        stopping.store(false, std::memory_order_relaxed);
+        worker = std::thread(&StreamServer::loop, this);
+        return true;
+}
+
+void StreamServer::stop()
+{
+        if (listen_fd < 0)
+        {
+                return;
+        }
+        stopping.store(true, std::memory_order_release);
+        uint64_t one = 1;
+        (void)!write(wake_fd, &one, sizeof(one));
+        worker.join();
+
+        for (auto &entry : sessions)
+        {
+                close(entry.first);
+        }
+        sessions.clear();
+        session_count.store(0, std::memory_order_relaxed);
+        close(listen_fd);
+        close(epoll_fd);
+        close(wake_fd);
+        listen_fd = epoll_fd = wake_fd = -1;
+        if (!unix_path.empty())
+        {
+                unlink(unix_path.c_str());
+        }
+}
+
+void StreamServer::publish(const Chip8 &chip8, uint32_t frame)
+{
+        if (listen_fd < 0)
+        {
+                return;
+        }
+        uint32_t version = chip8.display_version();
+        if (published_any && version == published_version)
+        {
+                skipped_count.fetch_add(1, std::memory_order_relaxed);
+                return;
+        }
+        published_version = version;
+
+        Rows current;
+        uint32_t mask = 0;
+        for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+        {
+                const uint32_t *pixels = &chip8.display[row * VIDEO_WIDTH];
+                uint64_t bits = 0;
+                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                {
+                        bits = (bits << 1) | (pixels[x] ? 1u : 0u);
+                }
+                current[row] = bits;
+                mask |= uint32_t(bits != published_rows[row]) << row;
+        }
+        if (!published_any)
+        {
+                mask = 0xffffffffu;
+        }
+        if (mask == 0)
+        {
+                // Sprites drawn twice, or a clear of a clear display
+                skipped_count.fetch_add(1, std::memory_order_relaxed);
+                return;
+        }
+        published_rows = current;
+        published_any = true;
+
+        Packet packet = encode_frame(0, frame, mask, current.data());
+        encoded_count.fetch_add(1, std::memory_order_relaxed);
+        {
+                std::lock_guard<std::mutex> lock(pending_lock);
+                pending.push_back({std::move(packet), current});
+        }
+        uint64_t one = 1;
+        (void)!write(wake_fd, &one, sizeof(one));
+}
+
+StreamStats StreamServer::stats() const
+{
+        StreamStats out;
+        out.sessions = session_count.load(std::memory_order_relaxed);
+        out.accepted = accepted_count.load(std::memory_order_relaxed);
+        out.encoded = encoded_count.load(std::memory_order_relaxed);
+        out.keyframes = keyframe_count.load(std::memory_order_relaxed);
+        out.skipped = skipped_count.load(std::memory_order_relaxed);
+        out.bytes_sent = sent_bytes.load(std::memory_order_relaxed);
+        out.keys = key_count.load(std::memory_order_relaxed);
+        return out;
+}
+
+void StreamServer::loop()
+{
+        epoll_event events[MAX_EVENTS];
+        std::vector<Published> published;
+        std::vector<int> closing;
+        auto linger_until = std::chrono::steady_clock::time_point::max();
+
+        for (;;)
+        {
+                if (stopping.load(std::memory_order_acquire))
+                {
+                        auto now = std::chrono::steady_clock::now();
+                        if (linger_until == std::chrono::steady_clock::time_point::max())
+                        {
+                                linger_until = now + std::chrono::milliseconds(STOP_LINGER_MS);
+                                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, nullptr);
+                        }
+                        bool queued = false;
+                        for (auto &entry : sessions)
+                        {
+                                queued |= !entry.second.backlog.empty();
+                        }
+                        if (!queued || now >= linger_until)
+                        {
+                                return;
+                        }
+                }
+
+                int count = epoll_wait(epoll_fd, events, MAX_EVENTS, stopping.load(std::memory_order_acquire) ? 10 : -1);
+                if (count < 0 && errno != EINTR)
+                {
+                        return;
+                }
+
+                for (int i = 0; i < count; ++i)
+                {
+                        int fd = events[i].data.fd;
+                        if (fd == listen_fd)
+                        {
+                                accept_sessions();
+                                continue;
+                        }
+                        if (fd == wake_fd)
+                        {
+                                uint64_t value;
+                                (void)!read(wake_fd, &value, sizeof(value));
+                                continue;
+                        }
+
+                        auto found = sessions.find(fd);
+                        if (found == sessions.end())
+                        {
+                                continue;
+                        }
+                        Session &session = found->second;
+                        if (events[i].events & (EPOLLERR | EPOLLHUP))
+                        {
+                                closing.push_back(fd);
+                                continue;
+                        }
+                        if (events[i].events & EPOLLIN)
+                        {
+                                read_session(session);
+                        }
+                        if (session.fd >= 0 && (events[i].events & EPOLLOUT) && !write_session(session))
+                        {
+                                session.fd = -1;
+                        }
+                        if (session.fd < 0)
+                        {
+                                closing.push_back(fd);
+                        }
+                }
+
+                // Fan out everything published since the last wakeup, in order.
+                // Each packet is encoded once and shared by every session.
+                {
+                        std::lock_guard<std::mutex> lock(pending_lock);
+                        published.swap(pending);
+                }
+                for (Published &entry : published)
+                {
+                        rows = entry.rows;
+                        frame_number = stream_get32(entry.packet->data() + 4);
+                        current_keyframe.reset();
+                        for (auto &session : sessions)
+                        {
+                                queue(session.second, entry.packet);
+                        }
+                }
+                if (!published.empty())
+                {
+                        for (auto &entry : sessions)
+                        {
+                                Session &session = entry.second;
+                                if (session.fd >= 0 && !session.writing && !write_session(session))
+                                {
+                                        closing.push_back(entry.first);
+                                }
+                        }
+                }
+                published.clear();
+
+                for (int fd : closing)
+                {
+                        close_session(fd);
+                }
+                closing.clear();
+        }
+}
+
+void StreamServer::accept_sessions()
+{
+        for (;;)
+        {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                {
+                        return;
+                }
+                if (!unix_socket)
+                {
+                        // Frames are small and latency matters more than packing them
+                        int nodelay = 1;
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                }
+
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+                {
+                        close(fd);
+                        continue;
+                }
+
+                Session &session = sessions[fd];
+                session.fd = fd;
+                session.backlog.push_back(hello);
+                session.backlog.push_back(keyframe());
+                accepted_count.fetch_add(1, std::memory_order_relaxed);
+                session_count.store(sessions.size(), std::memory_order_relaxed);
+                if (!write_session(session))
+                {
+                        close_session(fd);
+                }
+        }
+}
+
+void StreamServer::read_session(Session &session)
+{
+        uint8_t buffer[512];
+        for (;;)
+        {
+                ssize_t length = recv(session.fd, buffer, sizeof(buffer), 0);
+                if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                        session.fd = -1;
+                        return;
+                }
+                if (length < 0)
+                {
+                        return;
+                }
+
+                // Viewers only ever send key packets; anything else ends the session
+                for (ssize_t i = 0; i < length; ++i)
+                {
+                        session.input[session.input_length++] = buffer[i];
+                        if (session.input_length == STREAM_HEADER_SIZE &&
+                            (session.input[0] != STREAM_KEY || stream_get16(session.input + 2) != STREAM_KEY_SIZE))
+                        {
+                                session.fd = -1;
+                                return;
+                        }
+                        if (session.input_length < sizeof(session.input))
+                        {
+                                continue;
+                        }
+                        session.input_length = 0;
+                        uint8_t key = session.input[STREAM_HEADER_SIZE];
+                        if (key < 16)
+                        {
+                                key_queue.push({input_clock_ns(), key, session.input[STREAM_HEADER_SIZE + 1] != 0});
+                                key_count.fetch_add(1, std::memory_order_relaxed);
+                        }
+                }
+        }
+}
+
+bool StreamServer::write_session(Session &session)
+{
+        while (!session.backlog.empty())
+        {
+                iovec parts[MAX_IOVECS];
+                unsigned int used = 0;
+                for (auto packet = session.backlog.begin(); packet != session.backlog.end() && used < MAX_IOVECS;
+                     ++packet, ++used)
+                {
+                        size_t skip = (used == 0) ? session.offset : 0;
+                        parts[used].iov_base = const_cast<uint8_t *>((*packet)->data()) + skip;
+                        parts[used].iov_len = (*packet)->size() - skip;
+                }
+
+                msghdr message{};
+                message.msg_iov = parts;
+                message.msg_iovlen = used;
+                ssize_t sent = sendmsg(session.fd, &message, MSG_NOSIGNAL);
+                if (sent < 0)
+                {
+                        if (errno == EINTR)
+                        {
+                                continue;
+                        }
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        {
+                                return false;
+                        }
+                        watch_writes(session, true);
+                        return true;
+                }
+                sent_bytes.fetch_add(sent, std::memory_order_relaxed);
+
+                size_t left = sent;
+                while (left > 0)
+                {
+                        size_t remaining = session.backlog.front()->size() - session.offset;
+                        if (left < remaining)
+                        {
+                                session.offset += left;
+                                break;
+                        }
+                        left -= remaining;
+                        session.offset = 0;
+                        session.backlog.pop_front();
+                }
+        }
+        watch_writes(session, false);
+        return true;
+}
+
+void StreamServer::queue(Session &session, const Packet &packet)
+{
+        if (session.backlog.size() < MAX_BACKLOG)
+        {
+                session.backlog.push_back(packet);
+                return;
+        }
+
+        // Too far behind to be worth replaying: keep only a packet already
+        // partly on the wire, then jump straight to the current display
+        Packet partial = session.offset ? session.backlog.front() : nullptr;
+        session.backlog.clear();
+        if (partial)
+        {
+                session.backlog.push_back(std::move(partial));
+        }
+        session.backlog.push_back(keyframe());
+}
+
+void StreamServer::watch_writes(Session &session, bool enable)
+{
+        if (session.writing == enable)
+        {
+                return;
+        }
+        epoll_event event{};
+        event.events = enable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = session.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session.fd, &event);
+        session.writing = enable;
+}
+
+void StreamServer::close_session(int fd)
+{
+        if (sessions.erase(fd))
+        {
+                close(fd);
+                session_count.store(sessions.size(), std::memory_order_relaxed);
+        }
+}
+
+StreamServer::Packet StreamServer::keyframe()
+{
+        if (!current_keyframe)
+        {
+                current_keyframe = encode_frame(STREAM_KEYFRAME, frame_number, 0xffffffffu, rows.data());
+                keyframe_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        return current_keyframe;
+}
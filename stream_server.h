@@ -0,0 +1,124 @@
+#pragma once
+
+#include "chip8.h"
+#include "key_events.h"
+#include "stream_protocol.h"
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct StreamStats
+{
+        uint64_t sessions{};       // connected now
+        uint64_t accepted{};
+        uint64_t encoded{};        // frame packets built by publish, each shared by every session
+        uint64_t keyframes{};      // full frames built for sessions joining or catching up
+        uint64_t skipped{};        // frames publish skipped because nothing was drawn
+        uint64_t bytes_sent{};
+        uint64_t keys{};
+};
+
+// Streams one Chip8's display to any number of viewers and takes keypad
+// events back (protocol in stream_protocol.h).
+//
+// The emulation thread calls publish() once per frame. If the display
+// version moved it packs the display, and if rows really changed encodes
+// one delta packet. All socket work happens on a single epoll thread, which
+// queues a reference to that one packet on every session. A session that
+// falls too far behind has its backlog replaced by a keyframe.
+class StreamServer
+{
+public:
+        // Packets queued per session before it is resynchronised
+        static constexpr unsigned int MAX_BACKLOG = 128;
+        static constexpr unsigned int STOP_LINGER_MS = 100;
+
+        StreamServer() = default;
+        ~StreamServer();
+
+        StreamServer(const StreamServer &) = delete;
+        StreamServer &operator=(const StreamServer &) = delete;
+
+        // Binds address ("unix:<path>" or "tcp:<port>") and starts the event loop
+        bool listen(const std::string &address);
+        // Gives sessions up to STOP_LINGER_MS to take what is queued, then
+        // closes them
+        void stop();
+
+        void publish(const Chip8 &chip8, uint32_t frame);
+
+        // Viewer key events; point Chip8::input here. The event loop is its
+        // only producer.
+        KeyEventQueue &keys() { return key_queue; }
+
+        StreamStats stats() const;
+
+private:
+        using Packet = std::shared_ptr<const std::vector<uint8_t>>;
+        using Rows = std::array<uint64_t, STREAM_HEIGHT>;
+
+        struct Published
+        {
+                Packet packet;
+                Rows rows;                   // display after the packet
+        };
+
+        struct Session
+        {
+                int fd;
+                std::deque<Packet> backlog;
+                size_t offset{};             // bytes of backlog.front() already sent
+                uint8_t input[STREAM_HEADER_SIZE + STREAM_KEY_SIZE];
+                size_t input_length{};
+                bool writing{};              // registered for EPOLLOUT
+        };
+
+        void loop();
+        void accept_sessions();
+        void read_session(Session &session);
+        bool write_session(Session &session);
+        void queue(Session &session, const Packet &packet);
+        void watch_writes(Session &session, bool enable);
+        void close_session(int fd);
+        Packet keyframe();
+
+        int listen_fd{-1};
+        int epoll_fd{-1};
+        int wake_fd{-1};
+        std::string unix_path;
+        std::thread worker;
+        std::atomic<bool> stopping{false};
+
+        // Publisher side
+        Rows published_rows{};
+        uint32_t published_version{};
+        bool published_any{};
+
+        // Handed from publish() to the event loop
+        std::mutex pending_lock;
+        std::vector<Published> pending;
+
+        // Event loop side
+        std::unordered_map<int, Session> sessions;
+        Rows rows{};
+        uint32_t frame_number{};
+        bool unix_socket{};
+        Packet current_keyframe;
+        Packet hello;
+        KeyEventQueue key_queue;
+
+        std::atomic<uint64_t> accepted_count{0};
+        std::atomic<uint64_t> session_count{0};
+        std::atomic<uint64_t> encoded_count{0};
+        std::atomic<uint64_t> keyframe_count{0};
+        std::atomic<uint64_t> skipped_count{0};
+        std::atomic<uint64_t> sent_bytes{0};
+        std::atomic<uint64_t> key_count{0};
+};
@@ -0,0 +1,98 @@
+#include "stream_client.h"
+#include <poll.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Connects Viewers clients to a chip8-serve, taps keys from the first one and
+// follows the stream until the server goes away or Seconds pass, then checks
+// that every viewer ended up with the same display
+int main(int argc, char ** argv)
+{
+	if (argc < 2 || argc > 5) {
+		std::cerr << "Usage: " << argv[0] << " <Address> [Seconds] [Viewers] [Keys]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	double seconds = (argc > 2) ? std::stod(argv[2]) : 5.0;
+	unsigned int count = (argc > 3) ? std::stoi(argv[3]) : 1;
+	std::string keys = (argc > 4) ? argv[4] : "";
+	if (count == 0) {
+		std::cerr << "Viewers must be at least 1\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	// The server may not be listening yet
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::duration<double>(seconds);
+	std::vector<std::unique_ptr<StreamClient>> viewers;
+	while (viewers.size() < count) {
+		auto viewer = std::make_unique<StreamClient>();
+		if (viewer->connect(argv[1])) {
+			viewers.push_back(std::move(viewer));
+		}
+		else if (std::chrono::steady_clock::now() >= deadline) {
+			std::cerr << "Could not connect to " << argv[1] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	// Each key in Keys, hex digits, is held for 100 ms every 500 ms
+	std::vector<pollfd> fds(count);
+	std::vector<bool> open(count, true);
+	unsigned int connected = count;
+	size_t next_key = 0;
+	bool key_down = false;
+	auto key_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+	while (connected > 0 && std::chrono::steady_clock::now() < deadline) {
+		auto now = std::chrono::steady_clock::now();
+		if (open[0] && next_key < keys.size() && now >= key_time) {
+			uint8_t key = std::stoi(keys.substr(next_key, 1), nullptr, 16);
+			viewers[0]->send_key(key, !key_down);
+			key_down = !key_down;
+			next_key += !key_down;
+			key_time = now + std::chrono::milliseconds(key_down ? 100 : 400);
+		}
+
+		for (unsigned int i = 0; i < count; ++i) {
+			fds[i] = {open[i] ? viewers[i]->fd() : -1, POLLIN, 0};
+		}
+		if (poll(fds.data(), fds.size(), 10) < 0) {
+			break;
+		}
+		for (unsigned int i = 0; i < count; ++i) {
+			if (open[i] && fds[i].revents && !viewers[i]->poll()) {
+				open[i] = false;
+				--connected;
+			}
+		}
+	}
+
+	const StreamClient &first = *viewers[0];
+	for (unsigned int y = 0; y < STREAM_HEIGHT; ++y) {
+		std::string line;
+		for (unsigned int x = 0; x < STREAM_WIDTH; ++x) {
+			line += first.pixel(x, y) ? '#' : '.';
+		}
+		std::cout << line << "\n";
+	}
+
+	unsigned int agree = 0;
+	uint64_t frames = 0, keyframes = 0, bytes = 0;
+	for (auto &viewer : viewers) {
+		agree += viewer->ready() && viewer->rows() == first.rows() && viewer->frame() == first.frame();
+		frames += viewer->frames();
+		keyframes += viewer->keyframes();
+		bytes += viewer->bytes_received();
+	}
+	std::cout << "frame " << first.frame() << ", " << count << " viewers, " << agree << " agree, "
+	          << frames / count << " packets and " << bytes / count << " bytes per viewer, "
+	          << keyframes << " keyframes\n";
+	return (first.ready() && agree == count) ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+
+// COSMAC VIP timing model, used when CHIP8_VIP_TIMING is defined.
+//
+// Costs are in 1802 machine cycles (8 clocks at 1.7609 MHz, ~4.54us) and
+// approximate what the original VIP interpreter spends on each instruction,
+// including its fetch/decode overhead.
+
+const unsigned int VIP_CYCLES_PER_FRAME = 3668;    // one 60 Hz field
+const unsigned int VIP_INTERRUPT_CYCLES = 1832;    // 1861 DMA and timer interrupt per field
+const unsigned int VIP_FETCH_CYCLES = 40;
+
+// Base cost by the high nibble of the opcode
+constexpr std::array<uint16_t, 16> VIP_BASE_CYCLES = {
+    24,  // 0 - 00E0 / 00EE / 0nnn, see vip_instruction_cycles
+    12,  // 1nnn
+    26,  // 2nnn
+    10,  // 3xkk
+    10,  // 4xkk
+    14,  // 5xy0
+    6,   // 6xkk
+    10,  // 7xkk
+    44,  // 8xyN
+    14,  // 9xy0
+    12,  // Annn
+    22,  // Bnnn
+    36,  // Cxkk
+    26,  // Dxyn, plus per-row cost
+    14,  // Ex9E / ExA1
+    10,  // FxNN, see vip_instruction_cycles
+};
+
+const unsigned int VIP_SKIP_CYCLES = 4;
+const unsigned int VIP_CLS_CYCLES = 3078;
+const unsigned int VIP_RET_SAVED_CYCLES = 14;      // 00EE is cheaper than the 0 group base
+const unsigned int VIP_DRAW_ROW_CYCLES = 68;
+const unsigned int VIP_ADD_I_CYCLES = 6;           // Fx1E
+const unsigned int VIP_FONT_CYCLES = 6;            // Fx29
+const unsigned int VIP_BCD_CYCLES = 70;            // Fx33, plus per-digit cost
+const unsigned int VIP_BCD_DIGIT_CYCLES = 16;
+const unsigned int VIP_BCD_DIGITS = 3;
+const unsigned int VIP_REG_TRANSFER_CYCLES = 4;    // Fx55 / Fx65, plus per-register cost
+const unsigned int VIP_REG_BYTE_CYCLES = 14;
+
+constexpr uint32_t vip_instruction_cycles(uint16_t opcode, bool skipped)
+{
+        uint8_t op = (opcode & 0xf000u) >> 12u;
+        uint8_t x = (opcode & 0x0f00u) >> 8u;
+        uint8_t n = opcode & 0x000fu;
+        uint32_t cycles = VIP_FETCH_CYCLES + VIP_BASE_CYCLES[op];
+
+        if (skipped)
+        {
+                cycles += VIP_SKIP_CYCLES;
+        }
+
+        switch (op)
+        {
+        case 0x0:
+                if (opcode == 0x00e0)
+                {
+                        cycles += VIP_CLS_CYCLES;
+                }
+                else if (opcode == 0x00ee)
+                {
+                        cycles -= VIP_RET_SAVED_CYCLES;
+                }
+                break;
+        case 0xd:
+                cycles += n * VIP_DRAW_ROW_CYCLES;
+                break;
+        case 0xf:
+                switch (opcode & 0xffu)
+                {
+                case 0x1e:
+                        cycles += VIP_ADD_I_CYCLES;
+                        break;
+                case 0x29:
+                        cycles += VIP_FONT_CYCLES;
+                        break;
+                case 0x33:
+                        cycles += VIP_BCD_CYCLES + VIP_BCD_DIGITS * VIP_BCD_DIGIT_CYCLES;
+                        break;
+                case 0x55:
+                case 0x65:
+                        cycles += VIP_REG_TRANSFER_CYCLES + (x + 1) * VIP_REG_BYTE_CYCLES;
+                        break;
+                }
+                break;
+        }
+
+        return cycles;
+}
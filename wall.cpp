@@ -0,0 +1,83 @@
+#include "platform.h"
+#include "scheduler.h"
+#include "wall_view.h"
+#include <iostream>
+
+int main(int argc, char ** argv)
+{
+	if (argc < 4 || argc > 6) {
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Columns> <Rows> [Scale] [Workers]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	unsigned int columns = std::stoi(argv[2]);
+	unsigned int rows = std::stoi(argv[3]);
+	int video_scale = (argc > 4) ? std::stoi(argv[4]) : 1;
+	unsigned int workers = (argc > 5) ? std::stoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency());
+
+	WallView wall(columns, rows);
+
+	Chip8 initial;
+	initial.load_rom(argv[1]);
+
+	// Instances run paced at 60 Hz until the window closes
+	Scheduler scheduler(workers, std::chrono::microseconds(16667));
+	for (unsigned int i = 0; i < wall.tiles(); ++i) {
+		initial.seed(i);
+		scheduler.spawn(initial, UINT64_MAX);
+	}
+	scheduler.on_frame = [&wall](Instance &instance) {
+		wall.publish(instance.id, instance.chip8);
+	};
+
+	Platform platform("CHIP-8 Wall", wall.width() * video_scale, wall.height() * video_scale,
+	                  wall.width(), wall.height(), true);
+	platform.UpdateRect(0, 0, wall.width(), wall.height(), wall.pixels(), wall.pitch());
+
+	std::thread emulation(&Scheduler::run, &scheduler);
+
+	// Presents at most once per display refresh, uploading only changed tiles
+	const auto refresh_time = std::chrono::microseconds(1000000 / platform.RefreshRate());
+	auto lastPresentTime = std::chrono::steady_clock::now();
+	uint16_t keys = 0;
+	uint16_t held = 0;
+	bool quit = false;
+
+	while (!quit)
+	{
+		// Keys go to every instance
+		quit = platform.ProcessInput(keys);
+		if (keys != held) {
+			held = keys;
+			for (auto &instance : scheduler.instances()) {
+				scheduler.set_keys(*instance, held);
+			}
+		}
+
+		auto currentTime = std::chrono::steady_clock::now();
+		if (currentTime - lastPresentTime < refresh_time) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		lastPresentTime = currentTime;
+
+		if (wall.collect() > 0) {
+			int pitch = wall.pitch();
+			for (unsigned int row = 0; row < wall.spans().size(); ++row) {
+				WallView::Span span = wall.spans()[row];
+				if (span.first > span.last) {
+					continue;
+				}
+				int x = wall.tile_x(span.first);
+				int y = wall.tile_y(row);
+				int width = wall.tile_x(span.last) + VIDEO_WIDTH - x;
+				platform.UpdateRect(x, y, width, VIDEO_HEIGHT, wall.pixels() + size_t(y) * wall.width() + x, pitch);
+			}
+		}
+		platform.Present();
+	}
+
+	scheduler.stop();
+	emulation.join();
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include "wall_view.h"
+
+#include <algorithm>
+
+WallView::WallView(unsigned int columns, unsigned int rows)
+    : columns(std::max(1u, columns)), rows(std::max(1u, rows))
+{
+        tile_state = std::make_unique<Tile[]>(tiles());
+        image.assign(size_t(width()) * height(), GUTTER_COLOUR);
+        dirty_spans.resize(this->rows);
+
+        // Every tile starts blank, leaving only the gutters in gutter colour
+        for (unsigned int tile = 0; tile < tiles(); ++tile)
+        {
+                uint32_t *corner = &image[size_t(tile_y(tile / this->columns)) * width() + tile_x(tile % this->columns)];
+                for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+                {
+                        std::fill_n(corner + size_t(y) * width(), VIDEO_WIDTH, OFF_COLOUR);
+                }
+        }
+}
+
+void WallView::publish(unsigned int tile, const Chip8 &chip8)
+{
+        if (tile >= tiles())
+        {
+                return;
+        }
+
+        std::array<uint64_t, VIDEO_HEIGHT> packed;
+        for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+        {
+                const uint32_t *pixels = &chip8.display[y * VIDEO_WIDTH];
+                uint64_t bits = 0;
+                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                {
+                        bits = (bits << 1) | (pixels[x] ? 1u : 0u);
+                }
+                packed[y] = bits;
+        }
+
+        Tile &state = tile_state[tile];
+        std::lock_guard<std::mutex> guard(state.lock);
+        if (packed != state.rows)
+        {
+                state.rows = packed;
+                state.dirty = true;
+        }
+}
+
+unsigned int WallView::collect()
+{
+        unsigned int redrawn = 0;
+        std::array<uint64_t, VIDEO_HEIGHT> packed;
+
+        for (unsigned int row = 0; row < rows; ++row)
+        {
+                Span &span = dirty_spans[row];
+                span = Span{columns, 0};
+
+                for (unsigned int column = 0; column < columns; ++column)
+                {
+                        Tile &state = tile_state[row * columns + column];
+                        {
+                                std::lock_guard<std::mutex> guard(state.lock);
+                                if (!state.dirty)
+                                {
+                                        continue;
+                                }
+                                packed = state.rows;
+                                state.dirty = false;
+                        }
+
+                        uint32_t *corner = &image[size_t(tile_y(row)) * width() + tile_x(column)];
+                        for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+                        {
+                                uint32_t *line = corner + size_t(y) * width();
+                                for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+                                {
+                                        line[x] = ((packed[y] >> (VIDEO_WIDTH - 1 - x)) & 1u) ? ON_COLOUR : OFF_COLOUR;
+                                }
+                        }
+
+                        span.first = std::min(span.first, column);
+                        span.last = column;
+                        ++redrawn;
+                }
+        }
+        return redrawn;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Composes the displays of many instances into one RGBA8888 image, a grid
+// of columns x rows tiles with a one pixel gutter between them.
+//
+// publish() is called by whichever thread just ran an instance's frame; it
+// packs the display to one bit per pixel and marks the tile dirty only if a
+// pixel changed. collect() runs on the render thread and redraws just the
+// dirty tiles into pixels(), reporting per tile row which columns changed so
+// the caller can upload those spans and nothing else.
+class WallView
+{
+public:
+        static constexpr unsigned int GUTTER = 1;
+        static constexpr uint32_t ON_COLOUR = 0xffffffffu;
+        static constexpr uint32_t OFF_COLOUR = 0x000000ffu;
+        static constexpr uint32_t GUTTER_COLOUR = 0x303030ffu;
+
+        WallView(unsigned int columns, unsigned int rows);
+
+        unsigned int tiles() const { return columns * rows; }
+        unsigned int width() const { return columns * (VIDEO_WIDTH + GUTTER) - GUTTER; }
+        unsigned int height() const { return rows * (VIDEO_HEIGHT + GUTTER) - GUTTER; }
+
+        // Thread-safe for different tiles; tile is the instance's slot
+        void publish(unsigned int tile, const Chip8 &chip8);
+
+        // Columns [first, last] of one tile row changed; empty if first > last
+        struct Span
+        {
+                unsigned int first;
+                unsigned int last;
+        };
+
+        // Redraws tiles published since the last call; returns how many
+        unsigned int collect();
+        const std::vector<Span> &spans() const { return dirty_spans; }
+
+        // Pixel position of a tile's top left corner
+        unsigned int tile_x(unsigned int column) const { return column * (VIDEO_WIDTH + GUTTER); }
+        unsigned int tile_y(unsigned int row) const { return row * (VIDEO_HEIGHT + GUTTER); }
+
+        const uint32_t *pixels() const { return image.data(); }
+        int pitch() const { return width() * sizeof(uint32_t); }
+
+private:
+        struct alignas(64) Tile
+        {
+                std::mutex lock;
+                std::array<uint64_t, VIDEO_HEIGHT> rows{};
+                bool dirty{};
+        };
+
+        unsigned int columns;
+        unsigned int rows;
+        std::unique_ptr<Tile[]> tile_state;
+        std::vector<uint32_t> image;
+        std::vector<Span> dirty_spans;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+
+// XXH64 (https://github.com/Cyan4973/xxHash), enough of it to hash frames and
+// machine state. Produces the same values as the reference XXH64().
+
+namespace xxh64
+{
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl(uint64_t value, int bits)
+{
+        return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const uint8_t *p)
+{
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+}
+
+inline uint32_t read32(const uint8_t *p)
+{
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input)
+{
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t value)
+{
+        acc ^= round(0, value);
+        return acc * PRIME1 + PRIME4;
+}
+}
+
+inline uint64_t xxhash64(const void *data, std::size_t length, uint64_t seed = 0)
+{
+        using namespace xxh64;
+
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        const uint8_t *end = p + length;
+        uint64_t hash;
+
+        if (length >= 32)
+        {
+                uint64_t v1 = seed + PRIME1 + PRIME2;
+                uint64_t v2 = seed + PRIME2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - PRIME1;
+
+                do
+                {
+                        v1 = round(v1, read64(p));
+                        v2 = round(v2, read64(p + 8));
+                        v3 = round(v3, read64(p + 16));
+                        v4 = round(v4, read64(p + 24));
+                        p += 32;
+                } while (p + 32 <= end);
+
+                hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                hash = merge_round(hash, v1);
+                hash = merge_round(hash, v2);
+                hash = merge_round(hash, v3);
+                hash = merge_round(hash, v4);
+        }
+        else
+        {
+                hash = seed + PRIME5;
+        }
+
+        hash += length;
+
+        while (p + 8 <= end)
+        {
+                hash ^= round(0, read64(p));
+                hash = rotl(hash, 27) * PRIME1 + PRIME4;
+                p += 8;
+        }
+
+        if (p + 4 <= end)
+        {
+                hash ^= read32(p) * PRIME1;
+                hash = rotl(hash, 23) * PRIME2 + PRIME3;
+                p += 4;
+        }
+
+        while (p < end)
+        {
+                hash ^= *p * PRIME5;
+                hash = rotl(hash, 11) * PRIME1;
+                ++p;
+        }
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+}